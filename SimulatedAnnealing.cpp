@@ -1,4 +1,6 @@
 #include "stroke.h"
+#include "stroke_simd.h"
+#include "evaluator.h"
 #include <iostream>
 #include <random>
 #include <vector>
@@ -10,11 +12,47 @@
 #include <filesystem> // C++17: Para crear directorios
 #include <fstream>    // Para escribir el .txt
 #include <chrono>     // Para medir el tiempo
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <bit>
+#include <cstdint>
+#include <barrier>
+#include <thread>
+#include <functional>
 
 namespace fs = std::filesystem;
 
-// --- RNG Global  ---
-static std::mt19937 rng(std::random_device{}());
+// --- Contador de reservas de memoria (para el reporte) ---
+// Uno por hilo: cada corrida del pool cuenta sólo las suyas
+static thread_local long long g_heap_allocs = 0;
+
+void* operator new(std::size_t n) {
+    ++g_heap_allocs;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t n, std::align_val_t al) {
+    ++g_heap_allocs;
+    const std::size_t a = static_cast<std::size_t>(al);
+    if (void* p = std::aligned_alloc(a, (std::max<std::size_t>(n, 1) + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+// GCC no sabe que estos delete liberan lo que reservan los new de arriba
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+// --- RNG Global (uno por hilo) ---
+static thread_local std::mt19937 rng(std::random_device{}());
+
+// Reinicia el RNG de este hilo (corridas reproducibles)
+void seedRng(uint32_t seed) { rng.seed(seed); }
 
 int randInt(int min, int max) {
     std::uniform_int_distribution<int> dist(min, max);
@@ -33,7 +71,19 @@ static inline T clampT(T v, T lo, T hi) {
 
 // --- Parámetros del Problema ---
 const int N_STROKES = 50; 
-Canvas C_temp(0, 0);
+thread_local Canvas C_temp(0, 0); // canvas de calculate_mse (uno por hilo)
+bool cullHidden = false; // --cull: el render completo descarta trazos tapados
+
+// Render de evaluación: rotación cuantizada para reutilizar huellas en caché
+// y mezcla entera. Los PNG parciales y el final se pintan con las opciones
+// exactas por defecto (float).
+RenderOptions evalOpts = [] {
+    RenderOptions o;
+    o.exact = false;
+    o.rot_quantum_deg = 1.0f;
+    o.blend = BlendMode::Int8;
+    return o;
+}();
 
 // --- Estructura para Estadísticas ---
 struct RunStats {
@@ -44,23 +94,151 @@ struct RunStats {
 
 // --- Funciones del Modelo ---
 
-double calculate_mse(const std::vector<Stroke>& solution, const Canvas& C_target) {
-    // 1. Renderizar
+// MSE de un canvas ya pintado: suma entera exacta con el kernel SIMD
+// activo (da el mismo valor que acumular en double). Con cota: si (MSE
+// parcial - base_cost) llega a reject_delta, la suma ya prueba el rechazo
+// y se devuelve infinito sin terminar de recorrer. Se revisa fila por
+// fila (en planar, las tres del canal juntas) y las filas de 'first', que
+// son las que cambiaron, van primero: ahí está casi todo el delta.
+double canvas_mse(const Canvas& C, const Canvas& C_target, double base_cost = 0.0,
+                  double reject_delta = std::numeric_limits<double>::infinity(),
+                  const Rect& first = Rect()) {
+    const int H = C_target.height;
+    const size_t num_pixels = C_target.width * H;
+    if (num_pixels == 0) return std::numeric_limits<double>::max();
+    const double norm = (double)(num_pixels * 3);
+    const bool bounded = reject_delta < std::numeric_limits<double>::infinity();
+    const auto sse8 = strokeKernels().sse8;
+    const bool planar = C.planar() && C_target.planar();
+    const size_t row_bytes = size_t(C_target.width) * 3;
+
+    uint64_t sse = 0;
+    // Suma las filas [y0, y1); false si la cota ya prueba el rechazo
+    auto rows = [&](int y0, int y1) -> bool {
+        for (int y = y0; y < y1; ++y) {
+            if (planar) {
+                // Planar: cada fila de cada canal es contigua
+                for (int c = 0; c < 3; ++c)
+                    sse += sse8(C.plane(c) + size_t(y) * C.stride,
+                                C_target.plane(c) + size_t(y) * C_target.stride, C_target.width);
+            } else {
+                sse += sse8(C.rgb.data() + y * row_bytes, C_target.rgb.data() + y * row_bytes, (int)row_bytes);
+            }
+            if (bounded && (double)sse / norm - base_cost >= reject_delta) return false;
+        }
+        return true;
+    };
+
+    const int f0 = first.empty() ? 0 : std::clamp(first.y0, 0, H);
+    const int f1 = first.empty() ? 0 : std::clamp(first.y1, f0, H);
+    if (!rows(f0, f1) || !rows(0, f0) || !rows(f1, H)) return std::numeric_limits<double>::infinity();
+    return (double)sse / norm;
+}
+
+// 'changed': filas a revisar primero con cota (ver canvas_mse)
+double calculate_mse(const BrushAtlas& atlas, const std::vector<Stroke>& solution, const Canvas& C_target,
+                     double base_cost = 0.0,
+                     double reject_delta = std::numeric_limits<double>::infinity(),
+                     const Rect& changed = Rect()) {
+    if (C_temp.width != C_target.width || C_temp.height != C_target.height || C_temp.layout != C_target.layout)
+        C_temp = Canvas(C_target.width, C_target.height, C_target.layout);
     C_temp.clear(255, 255, 255); 
-    render(solution, C_temp);   
+    if (cullHidden) renderCulled(atlas, solution, C_temp, evalOpts);
+    else            render(atlas, solution, C_temp, evalOpts);
+    return canvas_mse(C_temp, C_target, base_cost, reject_delta, changed);
+}
 
-    // 2. Calcular MSE
-    double mse = 0.0;
-    const size_t num_pixels = C_target.width * C_target.height;
-    if (num_pixels == 0) return std::numeric_limits<double>::max();
+// Región que cambia al reemplazar un trazo: sus cajas antes y después
+Rect mutated_region(const BrushAtlas& atlas, const Stroke& before, const Stroke& after, const Canvas& C) {
+    return before.bounds(atlas, C.width, C.height, evalOpts)
+        .united(after.bounds(atlas, C.width, C.height, evalOpts));
+}
+
+// Deshacer una mutación: trazo, parámetro y su valor anterior (todos los
+// parámetros, incluidos color y tipo, se representan exactos en un float)
+struct MutationUndo {
+    int stroke_idx = -1;
+    int param_idx = 0;
+    float old_value = 0.0f;
+};
+
+float get_param(const Stroke& t, int param_idx) {
+    switch (param_idx) {
+        case 0: return t.x_rel;
+        case 1: return t.y_rel;
+        case 2: return t.size_rel;
+        case 3: return t.rotation_deg;
+        case 4: return t.r;
+        case 5: return t.g;
+        case 6: return t.b;
+        default: return (float)t.type;
+    }
+}
 
-    for (size_t i = 0; i < num_pixels * 3; ++i) {
-        double diff = (double)C_temp.rgb[i] - (double)C_target.rgb[i];
-        mse += diff * diff;
+void set_param(Stroke& t, int param_idx, float v) {
+    switch (param_idx) {
+        case 0: t.x_rel = v; break;
+        case 1: t.y_rel = v; break;
+        case 2: t.size_rel = v; break;
+        case 3: t.rotation_deg = v; break;
+        case 4: t.r = (uint8_t)v; break;
+        case 5: t.g = (uint8_t)v; break;
+        case 6: t.b = (uint8_t)v; break;
+        default: t.type = (int)v; break;
     }
-    return mse / (double)(num_pixels * 3);
 }
 
+void undo_mutation(std::vector<Stroke>& sol, const MutationUndo& u) {
+    set_param(sol[u.stroke_idx], u.param_idx, u.old_value);
+}
+
+// Hash de una solución: suma de un hash por (posición, trazo), así una
+// mutación lo actualiza en O(1) restando el del trazo viejo y sumando el nuevo
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t stroke_hash(int idx, const Stroke& t) {
+    uint64_t h = mix64(0x9e3779b97f4a7c15ULL * (uint64_t)(idx + 1));
+    h = mix64(h ^ ((uint64_t)std::bit_cast<uint32_t>(t.x_rel) << 32 | std::bit_cast<uint32_t>(t.y_rel)));
+    h = mix64(h ^ ((uint64_t)std::bit_cast<uint32_t>(t.size_rel) << 32 | std::bit_cast<uint32_t>(t.rotation_deg)));
+    h = mix64(h ^ ((uint64_t)(uint32_t)t.type << 32 | (uint64_t)t.r << 16 | (uint64_t)t.g << 8 | t.b));
+    return h;
+}
+
+uint64_t solution_hash(const std::vector<Stroke>& sol) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < sol.size(); ++i) h += stroke_hash((int)i, sol[i]);
+    return h;
+}
+
+// Caché de costos de soluciones ya evaluadas, de mapeo directo por hash.
+// Se guarda sólo el hash de 64 bits (no la solución): una colisión es
+// despreciable. Sólo se guardan costos exactos (no los cortados antes).
+struct CostCache {
+    struct Entry { uint64_t key = 0; double cost = 0.0; bool used = false; };
+    std::vector<Entry> entries;
+    long long hits = 0;
+
+    explicit CostCache(size_t n) : entries(n ? std::bit_ceil(n) : 0) {}
+    bool enabled() const { return !entries.empty(); }
+
+    bool find(uint64_t key, double& cost) {
+        if (!enabled()) return false;
+        const Entry& e = entries[key & (entries.size() - 1)];
+        if (!e.used || e.key != key) return false;
+        cost = e.cost;
+        ++hits;
+        return true;
+    }
+    void store(uint64_t key, double cost) {
+        if (!enabled()) return;
+        entries[key & (entries.size() - 1)] = Entry{key, cost, true};
+    }
+};
+
 /**
  * Mutate: Ahora recibe param_idx desde fuera para poder trackearlo
  */
@@ -96,94 +274,361 @@ std::vector<Stroke> create_random_solution(int N, int num_brushes) {
     return solution;
 }
 
-// --- Main ---
+// --- Evaluación especulativa ---
+// Hilos que reparten entre sí los trabajos 0..n-1 de run(n); el hilo que
+// llama también trabaja. El trabajo se fija una vez (así run() no reserva
+// memoria) y puede leer lo que escribió el que llama antes de run().
+class ProposalPool {
+public:
+    ProposalPool(int threads, std::function<void(int)> job)
+        : job(std::move(job)), start(std::max(1, threads)), done(std::max(1, threads)) {
+        for (int t = 1; t < threads; ++t) workers.emplace_back([this] { loop(); });
+    }
+    ~ProposalPool() {
+        stop = true;
+        start.arrive_and_wait();
+        for (auto& t : workers) t.join();
+    }
+    int threads() const { return (int)workers.size() + 1; }
 
-int main(int a, char** args) {
-    if (a != 3) {
-        std::cerr << "Uso: ./programa [nombre_imagen] [alpha]\n";
-        return 1;
+    void run(int n) {
+        jobs = n;
+        next = 0;
+        start.arrive_and_wait();
+        work();
+        done.arrive_and_wait();
     }
 
-    // --- 0. Configuración de Directorios y Tiempo ---
-    auto start_time = std::chrono::high_resolution_clock::now();
-    
-    std::string imgName = args[1];
-    std::string alphaStr = args[2];
-    float alpha = std::stof(alphaStr);
-    
-    // Crear carpeta ./parciales/nombre_alpha
-    std::string folderPath = std::format("parciales/{}_{}", imgName, alphaStr);
-    try {
-        if (!fs::exists("parciales")) fs::create_directory("parciales");
-        if (!fs::exists(folderPath)) fs::create_directory(folderPath);
-    } catch (const std::exception& e) {
-        std::cerr << "Error creando directorios: " << e.what() << "\n";
-        return 1;
+private:
+    void work() {
+        for (int k = next++; k < jobs; k = next++) job(k);
+    }
+    void loop() {
+        for (;;) {
+            start.arrive_and_wait();
+            if (stop) return;
+            work();
+            done.arrive_and_wait();
+        }
     }
 
-    std::string fuente = "instancias/" + imgName + ".png";
+    std::function<void(int)> job;
+    std::barrier<> start, done;
+    std::vector<std::thread> workers;
+    int jobs = 0;
+    std::atomic<int> next{0};
+    bool stop = false;
+};
 
-    // --- 1. Cargar Recursos ---
-    {
-        ImageGray b0, b1, b2, b3;
-        if (!loadImageGray("brushes/1.jpg", b0)) return 1;
-        if (!loadImageGray("brushes/2.jpg", b1)) return 1;
-        if (!loadImageGray("brushes/3.jpg", b2)) return 1;
-        if (!loadImageGray("brushes/4.jpg", b3)) return 1;
-        gBrushes.push_back(std::move(b0)); gBrushes.push_back(std::move(b1));
-        gBrushes.push_back(std::move(b2)); gBrushes.push_back(std::move(b3));
-    }
-    const int NUM_BRUSHES = gBrushes.size();
+// --- Configuración y resultado de una corrida ---
+struct AnnealConfig {
+    float alpha = 0.99f;
+    double T_inicial = 10000.0;
+    double T_final = 0.1;
+    int iter_por_temp = 250;
 
-    Canvas C_target(0, 0);
-    if (!loadImageRGB_asCanvas(fuente, C_target)) {
-        std::cerr << "Error cargando fuente.\n";
-        return 1;
+    bool incremental = true;
+    int check_cost = 0;
+    bool early_exit = false;
+    int screen_factor = 0;
+    double screen_margin = 0.0;
+    int checkpoint_every = 0;
+    size_t checkpoint_bytes = 0;
+    int cost_cache_size = 4096;
+    int speculate = 1;          // propuestas por paso (1 = secuencial)
+    int spec_threads = 1;
+
+    std::string partials_folder; // PNG parciales ("" = no se guardan)
+    bool verbose = true;
+
+    // Temperaturas de la cadena con este alpha
+    int steps() const {
+        return (alpha > 0.0f && alpha < 1.0f)
+            ? std::max(1, (int)std::ceil(std::log(T_final / T_inicial) / std::log(alpha))) : 1;
     }
-    C_temp = Canvas(C_target.width, C_target.height);
+};
+
+struct AnnealResult {
+    std::vector<Stroke> best;
+    double best_cost = std::numeric_limits<double>::max();
+    RunStats stats;
+    long long total_iter = 0;
+    int temp_step = 0;
+    double seconds = 0.0;
+    uint32_t seed = 0;
+
+    // Evaluación
+    double dirty_fraction = 1.0, strokes_per_eval = 0.0;
+    int checkpoint_step = 0;
+    long long early_exits = 0;
+    int cost_checks = 0, cost_mismatches = 0;
+    long long cache_hits = 0, cache_misses = 0; // caché de huellas
+
+    // Filtros
+    long long screen_evals = 0, screen_rejects = 0, screen_audits = 0, screen_false_rejects = 0;
+    long long noop_skips = 0, cost_cache_hits = 0;
+    size_t cost_cache_size = 0;
+
+    // Parallel tempering
+    int replicas = 1;
+    long long swaps_tried = 0, swaps_accepted = 0;
+    std::vector<double> ladder;       // escalera final, de fría a caliente
 
-    // --- 2. Parámetros SA ---
-    double T = 10000.0;         
-    const double T_final = 0.1; 
-    const int iter_por_temp = 250; 
+    long long loop_allocs = 0;
+    long long late_allocs = 0;        // en la segunda mitad de las temperaturas
+    int last_alloc_step = 0;
 
-    // --- 3. Estado Inicial ---
+    // Evaluación especulativa
+    long long spec_steps = 0, spec_evals = 0, spec_wasted = 0;
+};
+
+// --- Una cadena de SA ---
+AnnealResult run_annealing(const BrushAtlas& atlas, const Canvas& C_target, const AnnealConfig& cfg) {
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    const int NUM_BRUSHES = atlas.size();
+    const FootprintCache& fc = footprintCache();
+    const long long fc_hits0 = fc.hits, fc_misses0 = fc.misses;
+    AnnealResult res;
+
+    double T = cfg.T_inicial;
+    const double T_final = cfg.T_final;
+    const int iter_por_temp = cfg.iter_por_temp;
+    const bool incremental = cfg.incremental;
+
+    // --- Estado Inicial ---
     std::vector<Stroke> sol_actual = create_random_solution(N_STROKES, NUM_BRUSHES);
-    double costo_actual = calculate_mse(sol_actual, C_target);
+    IncrementalEvaluator evaluator(atlas, C_target, evalOpts);
+    evaluator.setCheckpoints(cfg.checkpoint_every, cfg.checkpoint_bytes);
+    double costo_actual = incremental ? evaluator.reset(sol_actual)
+                                      : calculate_mse(atlas, sol_actual, C_target);
 
+    // Proxy de baja resolución para el filtro (--screen)
+    Canvas C_proxy_target(0, 0);
+    std::unique_ptr<IncrementalEvaluator> proxy;
+    if (cfg.screen_factor > 1) {
+        C_proxy_target = C_target.downsample(cfg.screen_factor);
+        proxy = std::make_unique<IncrementalEvaluator>(atlas, C_proxy_target, evalOpts);
+        proxy->reset(sol_actual);
+    }
+    const bool predraw_u = cfg.early_exit || proxy;
+
+    // La mejor solución se copia sólo cuando el estado actual deja de serlo
+    // (mientras actual_es_mejor, sol_actual ES la mejor)
     std::vector<Stroke> sol_mejor = sol_actual;
     double costo_mejor = costo_actual;
-    
-    RunStats stats; // Estructura para guardar datos
+    bool actual_es_mejor = true;
+    auto mejor = [&]() -> const std::vector<Stroke>& { return actual_es_mejor ? sol_actual : sol_mejor; };
 
-    std::cout << "Inicio SA | Costo Inicial: " << costo_mejor << "\n";
+    RunStats& stats = res.stats; // Estructura para guardar datos
+    stats.mse_history.reserve(size_t(cfg.steps()) + 1);
 
-    // --- 4. Bucle SA ---
-    long long total_iter = 0;
-    int temp_step = 0; // Contador para nombrar los archivos parciales
+    // Hash de sol_actual (se actualiza con cada mutación) y caché de costos
+    uint64_t hash_actual = solution_hash(sol_actual);
+    // El especulativo no la consulta: no se reserva
+    CostCache cost_cache(cfg.speculate > 1 ? 0 : (size_t)cfg.cost_cache_size);
+    cost_cache.store(hash_actual, costo_actual);
+
+    if (cfg.verbose) std::cout << "Inicio SA | Costo Inicial: " << costo_mejor << "\n";
+
+    // --- Bucle SA ---
+    long long& total_iter = res.total_iter;
+    int& temp_step = res.temp_step; // Contador para nombrar los archivos parciales
+    const long long screen_audit_every = 16; // se audita 1 de cada 16 rechazos del filtro
+
+    // Especulativo (--speculate K): K mutaciones del estado actual, con su
+    // u ya sorteado, se evalúan a la vez en el pool. Luego se recorren en
+    // el orden en que se sortearon y se aplica la primera aceptada; las de
+    // después quedan descartadas, como si no se hubieran sorteado (la
+    // cadena secuencial las habría sorteado desde el estado nuevo). Las
+    // nulas se aceptan sin evaluar y no cortan el recorrido, porque no
+    // cambian el estado. Con --eval full no se usa el pool: las K
+    // soluciones candidatas se pintan juntas con renderBatch en este hilo
+    // (lo de debajo del trazo más bajo mutado se pinta una vez y cada
+    // huella se busca una vez para todas).
+    struct Proposal {
+        int stroke_idx = 0, param_idx = 0;
+        Stroke stroke;
+        double reject_delta = 0.0, costo = 0.0;
+        bool noop = false;
+    };
+    const int K = std::max(1, cfg.speculate);
+    std::vector<Proposal> props(K);
+    std::vector<IncrementalEvaluator::Scratch> scratch(K);
+    std::unique_ptr<ProposalPool> pool;
+    // Reservas y caché de huellas de los hilos del pool: los contadores son
+    // por hilo, así que se suman aparte los de los trabajadores (lo que
+    // corre en este hilo ya queda en los suyos)
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<long long> spec_allocs{0}, spec_hits{0}, spec_misses{0};
+    std::vector<std::vector<Stroke>> batch_sols;
+    std::vector<Canvas> batch_canvas;
+    std::vector<const std::vector<Stroke>*> batch_in;
+    std::vector<Canvas*> batch_out;
+    std::vector<int> batch_k;
+    if (K > 1 && !incremental) {
+        batch_sols.assign(K, sol_actual);
+        batch_canvas.assign(K, Canvas(C_target.width, C_target.height, C_target.layout));
+        batch_in.reserve(K);
+        batch_out.reserve(K);
+        batch_k.reserve(K);
+    }
+    auto evaluate_batch = [&](int n) {
+        batch_in.clear();
+        batch_out.clear();
+        batch_k.clear();
+        for (int k = 0; k < n; ++k) {
+            const Proposal& p = props[k];
+            if (p.noop) continue;
+            batch_sols[k] = sol_actual;
+            batch_sols[k][p.stroke_idx] = p.stroke;
+            batch_in.push_back(&batch_sols[k]);
+            batch_out.push_back(&batch_canvas[k]);
+            batch_k.push_back(k);
+        }
+        renderBatch(atlas, batch_in, batch_out, evalOpts);
+        for (int k : batch_k) {
+            Proposal& p = props[k];
+            const double bound = cfg.early_exit ? p.reject_delta : std::numeric_limits<double>::infinity();
+            const Rect changed = std::isinf(bound) ? Rect()
+                : mutated_region(atlas, sol_actual[p.stroke_idx], p.stroke, C_target);
+            p.costo = canvas_mse(batch_canvas[k], C_target, costo_actual, bound, changed);
+        }
+    };
+    if (K > 1 && incremental) {
+        pool = std::make_unique<ProposalPool>(std::min(cfg.spec_threads, K), [&](int k) {
+            Proposal& p = props[k];
+            if (p.noop) return;
+            const FootprintCache& wfc = footprintCache();
+            const long long allocs0 = g_heap_allocs, hits0 = wfc.hits, misses0 = wfc.misses;
+            const double bound = cfg.early_exit ? p.reject_delta : std::numeric_limits<double>::infinity();
+            p.costo = evaluator.evaluate(p.stroke_idx, p.stroke, scratch[k], bound);
+            if (std::this_thread::get_id() == caller) return;
+            spec_allocs.fetch_add(g_heap_allocs - allocs0, std::memory_order_relaxed);
+            spec_hits.fetch_add(wfc.hits - hits0, std::memory_order_relaxed);
+            spec_misses.fetch_add(wfc.misses - misses0, std::memory_order_relaxed);
+        });
+    }
+    // Devuelve cuántas iteraciones consumió (hasta la aceptada, o n)
+    auto speculative_step = [&](int n) -> int {
+        for (int k = 0; k < n; ++k) {
+            Proposal& p = props[k];
+            p.stroke_idx = randInt(0, N_STROKES - 1);
+            p.param_idx = randInt(0, 7);
+            p.stroke = sol_actual[p.stroke_idx];
+            apply_mutation(p.stroke, p.param_idx, NUM_BRUSHES);
+            p.noop = p.stroke == sol_actual[p.stroke_idx];
+            p.reject_delta = -T * std::log((double)randFloat(0.0f, 1.0f));
+            res.spec_evals += !p.noop;
+        }
+        if (pool) pool->run(n);
+        else      evaluate_batch(n);
+        ++res.spec_steps;
+
+        for (int k = 0; k < n; ++k) {
+            const Proposal& p = props[k];
+            stats.accepted_mutations[p.param_idx] += p.noop;
+            if (p.noop) { ++res.noop_skips; continue; }
+            if (std::isinf(p.costo)) ++res.early_exits;
+            if (!(p.costo - costo_actual < p.reject_delta)) continue;
+
+            // Aceptada: las evaluadas después se descartan
+            for (int m = k + 1; m < n; ++m) res.spec_wasted += !props[m].noop;
+            if (p.costo >= costo_mejor && actual_es_mejor) {
+                sol_mejor = sol_actual; // se sale del mejor estado
+                actual_es_mejor = false;
+            }
+            if (incremental) evaluator.accept(scratch[k]);
+            sol_actual[p.stroke_idx] = p.stroke;
+            costo_actual = p.costo;
+            stats.accepted_mutations[p.param_idx]++;
+            if (costo_actual < costo_mejor) {
+                costo_mejor = costo_actual;
+                actual_es_mejor = true;
+            }
+            return k + 1;
+        }
+        return n;
+    };
 
     while (T > T_final) {
+        const long long allocs_before = g_heap_allocs + spec_allocs.load(std::memory_order_relaxed);
 
         for (int i = 0; i < iter_por_temp; ++i) {
-            
-            // A. Crear copia para mutar
-            std::vector<Stroke> sol_nueva = sol_actual;
+            if (K > 1) {
+                i += speculative_step(std::min(K, iter_por_temp - i)) - 1;
+                continue;
+            }
 
-            // B. Seleccionar qué mutar (para llevar registro)
+            // A. Seleccionar qué mutar (para llevar registro)
             int stroke_idx = randInt(0, N_STROKES - 1);
             int param_idx = randInt(0, 7); // 0..7 variables
 
-            // C. Aplicar mutación específica
-            apply_mutation(sol_nueva[stroke_idx], param_idx, NUM_BRUSHES);
-            
-            // D. Evaluar
-            double costo_nuevo = calculate_mse(sol_nueva, C_target);
+            // B. Mutar en el lugar, guardando cómo deshacerlo
+            const MutationUndo undo{stroke_idx, param_idx, get_param(sol_actual[stroke_idx], param_idx)};
+            const Stroke undo_stroke = sol_actual[stroke_idx];
+            apply_mutation(sol_actual[stroke_idx], param_idx, NUM_BRUSHES);
+
+            // B.1 Mutación nula (el tipo sorteado de nuevo, un clamp en el
+            //     borde, un color en 0/255): delta 0, se acepta sin evaluar
+            //     y el estado no cambia
+            if (get_param(sol_actual[stroke_idx], param_idx) == undo.old_value) {
+                ++res.noop_skips;
+                stats.accepted_mutations[param_idx]++;
+                continue;
+            }
+            const uint64_t hash_nuevo = hash_actual - stroke_hash(stroke_idx, undo_stroke)
+                                      + stroke_hash(stroke_idx, sol_actual[stroke_idx]);
+
+            // C. Evaluar (incremental: sólo la región que cambió). Con
+            //    --early-exit o --screen, u se sortea antes: la propuesta se
+            //    acepta sii delta_E < -T ln(u), y la evaluación corta apenas
+            //    lo descarta.
+            double reject_delta = std::numeric_limits<double>::infinity();
+            if (predraw_u) reject_delta = -T * std::log((double)randFloat(0.0f, 1.0f));
+
+            // C.0 Solución ya evaluada: su costo sale de la caché
+            double costo_nuevo = std::numeric_limits<double>::infinity();
+            const bool cached = cost_cache.find(hash_nuevo, costo_nuevo);
+
+            // C.1 Filtro en baja resolución: si el delta del proxy no entra
+            //     con el margen, se rechaza sin evaluar en resolución completa
+            bool screened_out = false;
+            if (cfg.screen_factor > 1 && !cached) {
+                ++res.screen_evals;
+                const double proxy_delta =
+                    proxy->propose(stroke_idx, sol_actual[stroke_idx]) - proxy->cost();
+                screened_out = !(proxy_delta < reject_delta + cfg.screen_margin);
+            }
+
+            // Se audita 1 de cada N rechazos del filtro
+            const bool audit = screened_out && ++res.screen_rejects % screen_audit_every == 0;
+
+            if (!cached && (!screened_out || audit)) {
+                // u se sortea antes también para el filtro, pero la
+                // evaluación sólo se corta con --early-exit
+                const double bound = cfg.early_exit ? reject_delta : std::numeric_limits<double>::infinity();
+                costo_nuevo = incremental
+                    ? evaluator.propose(stroke_idx, sol_actual[stroke_idx], bound)
+                    : calculate_mse(atlas, sol_actual, C_target, costo_actual, bound,
+                                    std::isinf(bound) ? Rect()
+                                        : mutated_region(atlas, undo_stroke, sol_actual[stroke_idx], C_target));
+                if (std::isinf(costo_nuevo)) ++res.early_exits;
+                else cost_cache.store(hash_nuevo, costo_nuevo);
+            }
+            if (audit) {
+                // Muestra de los rechazados por el filtro: ¿se habría aceptado?
+                ++res.screen_audits;
+                if (costo_nuevo - costo_actual < reject_delta) ++res.screen_false_rejects;
+                costo_nuevo = std::numeric_limits<double>::infinity();
+            }
             double delta_E = costo_nuevo - costo_actual;
 
-            // E. Criterio de Aceptación
+            // D. Criterio de Aceptación
             bool accepted = false;
-            if (delta_E < 0) {
-                accepted = true; 
+            if (predraw_u) {
+                accepted = delta_E < reject_delta; // u < exp(-delta_E / T)
+            } else if (delta_E < 0) {
+                accepted = true;
             } else {
                 double prob = std::exp(-delta_E / T);
                 if (randFloat(0.0f, 1.0f) < prob) {
@@ -192,23 +637,48 @@ int main(int a, char** args) {
             }
 
             if (accepted) {
-                sol_actual = std::move(sol_nueva);
+                // Con el costo de la caché no hay región compuesta: se
+                // evalúa ahora para poder aceptarla
+                if (cached && incremental) evaluator.propose(stroke_idx, sol_actual[stroke_idx]);
+                if (cached && proxy) proxy->propose(stroke_idx, sol_actual[stroke_idx]);
+                if (incremental) evaluator.accept();
+                if (proxy) proxy->accept();
                 costo_actual = costo_nuevo;
+                hash_actual = hash_nuevo;
                 // Registrar éxito de este parámetro
-                stats.accepted_mutations[param_idx]++; 
+                stats.accepted_mutations[param_idx]++;
 
                 if (costo_actual < costo_mejor) {
-                    sol_mejor = sol_actual;
                     costo_mejor = costo_actual;
+                    actual_es_mejor = true;
+                } else if (actual_es_mejor) {
+                    // Se sale del mejor estado: guardarlo (sin reservar,
+                    // mismo tamaño) deshaciendo la mutación en la copia
+                    sol_mejor = sol_actual;
+                    undo_mutation(sol_mejor, undo);
+                    actual_es_mejor = false;
                 }
+            } else {
+                undo_mutation(sol_actual, undo);
             }
-        } 
+        }
+
+        const long long step_allocs = g_heap_allocs + spec_allocs.load(std::memory_order_relaxed) - allocs_before;
+        if (temp_step > 0) res.loop_allocs += step_allocs;
+        if (2 * temp_step >= cfg.steps()) res.late_allocs += step_allocs;
+        if (step_allocs > 0) res.last_alloc_step = temp_step;
 
         // 1. Guardar MSE actual
         stats.mse_history.push_back(costo_actual);
 
+        // Depuración: el costo incremental no debe derivar del completo
+        if (incremental && cfg.check_cost > 0 && temp_step % cfg.check_cost == 0) {
+            ++res.cost_checks;
+            if (evaluator.crossCheck() != 0) ++res.cost_mismatches;
+        }
+
         // Enfriamiento
-        T = T * alpha; 
+        T = T * cfg.alpha;
         total_iter += iter_por_temp;
         temp_step++;
 
@@ -217,47 +687,597 @@ int main(int a, char** args) {
             std::cout << "Iter: " << total_iter << " | T: " << T << " | MSE: " << costo_mejor << "\n";
         */
 
-        if (total_iter % (iter_por_temp * 500) == 0) {
+        if (!cfg.partials_folder.empty() && total_iter % (iter_por_temp * 500) == 0) {
             Canvas C_parcial(C_target.width, C_target.height);
-            render(sol_mejor, C_parcial); 
-            std::string pName = std::format("{}/iter_{:04d}_T_{:.2f}.png", folderPath, temp_step, T);
+            render(atlas, mejor(), C_parcial);
+            std::string pName = std::format("{}/iter_{:04d}_T_{:.2f}.png", cfg.partials_folder, temp_step, T);
             savePNG(C_parcial, pName);
         }
     }
 
+    res.best = mejor();
+    res.best_cost = costo_mejor;
+    res.dirty_fraction = incremental
+        ? (double)evaluator.dirty_pixels.load()
+              / std::max(1.0, (double)evaluator.evaluations.load() * C_target.width * C_target.height)
+        : 1.0;
+    res.strokes_per_eval = (double)evaluator.strokes_drawn.load() / std::max(1LL, evaluator.evaluations.load());
+    res.checkpoint_step = evaluator.checkpointStep();
+    res.cost_cache_hits = cost_cache.hits;
+    res.cost_cache_size = cost_cache.entries.size();
+    res.cache_hits = fc.hits - fc_hits0 + spec_hits.load();
+    res.cache_misses = fc.misses - fc_misses0 + spec_misses.load();
+    res.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+    return res;
+}
+
+// --- Parallel tempering ---
+// R réplicas, cada una en su hilo, a temperaturas fijas de una escalera
+// geométrica entre T_inicial y T_final. Tras cada ronda de iter_por_temp
+// iteraciones se proponen intercambios Metropolis entre vecinas de la
+// escalera (pares pares e impares alternados) y, cada adapt_every rondas,
+// se ajustan los saltos de la escalera hacia una tasa de intercambio
+// objetivo (los extremos quedan fijos). Cada réplica corre cfg.steps()
+// rondas. La réplica r usa la semilla seed + r; los intercambios, seed - 1.
+// No usa el filtro --screen, la caché de costos ni --check-cost; el resto
+// de las opciones de evaluación (--eval, --early-exit, checkpoints, --cull,
+// --blend, --layout, --simd) aplica igual que en run_annealing.
+struct TemperingConfig {
+    int replicas = 4;
+    int adapt_every = 10;
+    double swap_target = 0.23;
+    uint32_t seed = 0;
+};
+
+AnnealResult run_tempering(const BrushAtlas& atlas, const Canvas& C_target,
+                           const AnnealConfig& cfg, const TemperingConfig& tcfg) {
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    const int R = std::max(2, tcfg.replicas);
+    const int rounds = cfg.steps();
+    const int num_brushes = atlas.size();
+
+    // Escalera inicial geométrica; slot 0 = el más frío
+    std::vector<double> ladder(R);
+    for (int k = 0; k < R; ++k)
+        ladder[k] = cfg.T_final * std::pow(cfg.T_inicial / cfg.T_final, (double)k / (R - 1));
+    std::vector<int> who(R);         // réplica en cada slot
+    for (int k = 0; k < R; ++k) who[k] = k;
+    std::vector<double> energy(R);   // costo actual de cada réplica
+    std::vector<long long> tried(R - 1, 0), swapped(R - 1, 0); // ventana de adaptación
+    std::mt19937 swap_rng(tcfg.seed - 1);
+    std::uniform_real_distribution<double> swap_u(0.0, 1.0);
+
+    AnnealResult res;
+    res.replicas = R;
+    res.temp_step = rounds;
+    res.stats.mse_history.reserve(size_t(rounds));
+    std::vector<AnnealResult> part(R);
+    std::vector<long long> evals(R), dirty(R), drawn(R); // del evaluador de cada réplica
+    int round = 0;
+
+    // Fase de intercambio: la corre un solo hilo mientras los demás esperan
+    auto swap_phase = [&]() noexcept {
+        for (int k = round % 2; k + 1 < R; k += 2) {
+            const int a = who[k], b = who[k + 1];
+            const double x = (1.0 / ladder[k] - 1.0 / ladder[k + 1]) * (energy[a] - energy[b]);
+            ++tried[k];
+            ++res.swaps_tried;
+            if (x >= 0.0 || swap_u(swap_rng) < std::exp(x)) {
+                std::swap(who[k], who[k + 1]);
+                ++swapped[k];
+                ++res.swaps_accepted;
+            }
+        }
+        res.stats.mse_history.push_back(energy[who[0]]);
+
+        // Escalera adaptativa: un salto (en log T) con pocos intercambios
+        // se achica y uno con muchos se agranda; luego se reescalan para
+        // mantener T_final y T_inicial
+        if (tcfg.adapt_every > 0 && (round + 1) % tcfg.adapt_every == 0) {
+            std::vector<double> gap(R - 1);
+            double sum = 0.0;
+            for (int k = 0; k + 1 < R; ++k) {
+                const double rate = tried[k] ? (double)swapped[k] / tried[k] : tcfg.swap_target;
+                gap[k] = std::log(ladder[k + 1] / ladder[k]) * std::exp(rate - tcfg.swap_target);
+                sum += gap[k];
+                tried[k] = swapped[k] = 0;
+            }
+            const double span = std::log(cfg.T_inicial / cfg.T_final);
+            for (int k = 0; k + 1 < R; ++k) ladder[k + 1] = ladder[k] * std::exp(gap[k] * span / sum);
+            ladder[R - 1] = cfg.T_inicial;
+        }
+        ++round;
+    };
+    std::barrier sync(R, swap_phase);
+
+    auto replica = [&](int r) {
+        seedRng(tcfg.seed + (uint32_t)r);
+        AnnealResult& out = part[r];
+        const FootprintCache& fc = footprintCache();
+        std::vector<Stroke> sol = create_random_solution(N_STROKES, num_brushes);
+        IncrementalEvaluator evaluator(atlas, C_target, evalOpts);
+        evaluator.setCheckpoints(cfg.checkpoint_every, cfg.checkpoint_bytes);
+        double costo = cfg.incremental ? evaluator.reset(sol) : calculate_mse(atlas, sol, C_target);
+        out.best = sol;
+        out.best_cost = costo;
+
+        for (int n = 0; n < rounds; ++n) {
+            const long long allocs_before = g_heap_allocs;
+            // El slot de esta réplica sólo cambia en la fase de intercambio
+            const double T = ladder[std::find(who.begin(), who.end(), r) - who.begin()];
+            for (int i = 0; i < cfg.iter_por_temp; ++i) {
+                const int stroke_idx = randInt(0, N_STROKES - 1);
+                const int param_idx = randInt(0, 7);
+                const MutationUndo undo{stroke_idx, param_idx, get_param(sol[stroke_idx], param_idx)};
+                const Stroke old_stroke = sol[stroke_idx];
+                apply_mutation(sol[stroke_idx], param_idx, num_brushes);
+                if (get_param(sol[stroke_idx], param_idx) == undo.old_value) {
+                    ++out.noop_skips;
+                    out.stats.accepted_mutations[param_idx]++;
+                    continue;
+                }
+
+                // u se sortea antes: se acepta sii delta < -T ln(u)
+                const double reject_delta = -T * std::log((double)randFloat(0.0f, 1.0f));
+                const double bound = cfg.early_exit ? reject_delta : std::numeric_limits<double>::infinity();
+                const double costo_nuevo = cfg.incremental
+                    ? evaluator.propose(stroke_idx, sol[stroke_idx], bound)
+                    : calculate_mse(atlas, sol, C_target, costo, bound,
+                                    std::isinf(bound) ? Rect() : mutated_region(atlas, old_stroke, sol[stroke_idx], C_target));
+                if (std::isinf(costo_nuevo)) ++out.early_exits;
+
+                if (costo_nuevo - costo < reject_delta) {
+                    if (cfg.incremental) evaluator.accept();
+                    costo = costo_nuevo;
+                    out.stats.accepted_mutations[param_idx]++;
+                    if (costo < out.best_cost) {
+                        out.best_cost = costo;
+                        out.best = sol;
+                    }
+                } else {
+                    undo_mutation(sol, undo);
+                }
+            }
+            out.total_iter += cfg.iter_por_temp;
+            const long long step_allocs = g_heap_allocs - allocs_before;
+            if (n > 0) out.loop_allocs += step_allocs;
+            if (2 * n >= rounds) out.late_allocs += step_allocs;
+            if (step_allocs > 0) out.last_alloc_step = n;
+            energy[r] = costo;
+            sync.arrive_and_wait();
+        }
+        out.cache_hits = fc.hits;
+        out.cache_misses = fc.misses;
+        out.checkpoint_step = evaluator.checkpointStep();
+        evals[r] = evaluator.evaluations.load();
+        dirty[r] = evaluator.dirty_pixels.load();
+        drawn[r] = evaluator.strokes_drawn.load();
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(R);
+    for (int r = 0; r < R; ++r) threads.emplace_back(replica, r);
+    for (auto& t : threads) t.join();
+
+    // Mejor global y totales de todas las réplicas
+    for (const AnnealResult& p : part) {
+        if (p.best_cost < res.best_cost) {
+            res.best_cost = p.best_cost;
+            res.best = p.best;
+        }
+        for (int k = 0; k < 8; ++k) res.stats.accepted_mutations[k] += p.stats.accepted_mutations[k];
+        res.total_iter += p.total_iter;
+        res.noop_skips += p.noop_skips;
+        res.early_exits += p.early_exits;
+        res.cache_hits += p.cache_hits;
+        res.cache_misses += p.cache_misses;
+        res.loop_allocs += p.loop_allocs;
+        res.late_allocs += p.late_allocs;
+        res.last_alloc_step = std::max(res.last_alloc_step, p.last_alloc_step);
+        res.checkpoint_step = p.checkpoint_step;
+    }
+    long long total_evals = 0, total_dirty = 0, total_drawn = 0;
+    for (int r = 0; r < R; ++r) {
+        total_evals += evals[r];
+        total_dirty += dirty[r];
+        total_drawn += drawn[r];
+    }
+    res.dirty_fraction = cfg.incremental
+        ? (double)total_dirty / std::max(1.0, (double)total_evals * C_target.width * C_target.height)
+        : 1.0;
+    res.strokes_per_eval = (double)total_drawn / std::max(1LL, total_evals);
+    res.ladder = ladder;
+    res.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+    return res;
+}
+
+// --- Reporte ---
+// Escribe reporte.txt. El script de gráficas lee la segunda fila (el
+// último valor es el tiempo) y lo que sigue a "--- Historial MSE": las
+// demás estadísticas van como pares encabezado/valores antes de eso.
+bool write_report(const std::string& logName, const AnnealResult& res, const AnnealConfig& cfg,
+                  const BrushAtlas& atlas, const Canvas& C_target, double duration_sec,
+                  double final_mse) {
+    // Trazos de la mejor solución tapados por completo por texels opacos
+    // (alfa máximo). Sólo con --cull: con los pinceles incluidos ningún
+    // texel llega a opaco y la lista sale siempre vacía.
+    std::vector<int> hidden;
+    if (cullHidden) {
+        Canvas C_cull(C_target.width, C_target.height, C_target.layout);
+        renderCulled(atlas, res.best, C_cull, evalOpts, &hidden);
+    }
+
+    std::ofstream logFile(logName);
+    if (!logFile.is_open()) {
+        std::cerr << "No pude escribir " << logName << "\n";
+        return false;
+    }
+    const RunStats& stats = res.stats;
+    const long long total_iter = std::max(1LL, res.total_iter);
+
+    // Primera fila: Encabezados de contadores + Tiempo
+    logFile << "Mut_X Mut_Y Mut_Size Mut_Rot Mut_R Mut_G Mut_B Mut_Type Time_Sec\n";
+
+    // Segunda fila: Datos de contadores + Tiempo
+    for(int k=0; k<8; ++k) logFile << stats.accepted_mutations[k] << " ";
+    logFile << duration_sec << "\n";
+
+    // %
+    for(int k=0; k<8; ++k) logFile << stats.accepted_mutations[k]/total_iter << " ";
+    logFile << duration_sec << "\n";
+
+    // Caché de huellas de los trazos
+    logFile << "Cache_Hits Cache_Misses Cache_Hit_Rate Simd\n";
+    logFile << res.cache_hits << " " << res.cache_misses << " "
+            << (double)res.cache_hits / std::max(1LL, res.cache_hits + res.cache_misses) << " "
+            << simdLevelName(strokeKernels().level) << "\n";
+
+    // Evaluación incremental: fracción media del canvas recompuesta
+    logFile << "Eval_Mode Dirty_Pixel_Fraction Strokes_Per_Eval Checkpoint_Step Early_Exit_Rate Cost_Checks Cost_Mismatches\n";
+    logFile << (cfg.incremental ? "incremental" : "full") << " " << res.dirty_fraction
+            << " " << res.strokes_per_eval
+            << " " << res.checkpoint_step
+            << " " << (double)res.early_exits / total_iter
+            << " " << res.cost_checks << " " << res.cost_mismatches << "\n";
+
+    // Filtro de baja resolución: fracción que pasa y tasa de falsos
+    // rechazos estimada sobre la muestra auditada
+    logFile << "Screen_Factor Screen_Margin Screen_Pass_Rate Screen_Audits Screen_False_Reject_Rate\n";
+    logFile << cfg.screen_factor << " " << cfg.screen_margin << " "
+            << (res.screen_evals ? 1.0 - (double)res.screen_rejects / res.screen_evals : 1.0) << " "
+            << res.screen_audits << " "
+            << (double)res.screen_false_rejects / std::max(1LL, res.screen_audits) << "\n";
+
+    // Evaluaciones evitadas: mutaciones nulas y costos tomados de la caché
+    logFile << "Noop_Skips Cost_Cache_Hits Skipped_Eval_Rate Cost_Cache_Size\n";
+    logFile << res.noop_skips << " " << res.cost_cache_hits << " "
+            << (double)(res.noop_skips + res.cost_cache_hits) / total_iter << " "
+            << res.cost_cache_size << "\n";
+
+    // Evaluación especulativa: propuestas por paso, hilos y fracción de las
+    // evaluaciones descartadas por una aceptada antes en el mismo paso
+    logFile << "Speculate_K Spec_Threads Spec_Steps Spec_Wasted_Rate\n";
+    logFile << cfg.speculate << " " << (cfg.speculate > 1 ? std::min(cfg.spec_threads, cfg.speculate) : 1) << " "
+            << res.spec_steps << " " << (double)res.spec_wasted / std::max(1LL, res.spec_evals) << "\n";
+
+    // Semilla de la corrida (con ella se repite exactamente)
+    logFile << "Seed\n" << res.seed << "\n";
+
+    // Parallel tempering: réplicas, tasa de intercambio y escalera final
+    logFile << "Replicas Swap_Accept_Rate T_Ladder\n";
+    logFile << res.replicas << " " << (double)res.swaps_accepted / std::max(1LL, res.swaps_tried);
+    for (double t : res.ladder) logFile << " " << t;
+    logFile << "\n";
+
+    // Trazos tapados por texels opacos (sólo con --cull; si no, 0):
+    // cantidad y luego sus índices
+    logFile << "Opaque_Hidden_Strokes\n";
+    logFile << hidden.size();
+    for (int h : hidden) logFile << " " << h;
+    logFile << "\n";
+
+    // Reservas de memoria en el bucle SA. El índice y el scratch del
+    // evaluador se reservan antes; la caché de huellas pide buffers nuevos
+    // sólo cuando a una clase de tamaño no le queda ninguno libre. Régimen
+    // estable: reservas por temperatura en la segunda mitad.
+    logFile << "Loop_Heap_Allocs Last_Alloc_Step Late_Allocs_Per_Step Temp_Steps\n";
+    logFile << res.loop_allocs << " " << res.last_alloc_step << " "
+            << (double)res.late_allocs / std::max(1, res.temp_step / 2) << " "
+            << res.temp_step << "\n";
+
+    // "MSE Final" y el historial son el costo de evaluación; éste es el MSE
+    // de FINAL.png, pintada con el render exacto en float
+    logFile << "Final_Render_MSE\n";
+    logFile << final_mse << "\n";
+
+    logFile << "--- Historial MSE por cambio de temperatura ---\n";
+    for (double val : stats.mse_history) {
+        logFile << val << "\n";
+    }
+    logFile.close();
+    return true;
+}
+
+// --- Varias corridas ---
+// N corridas independientes repartidas en M hilos; la corrida k usa la
+// semilla seed + k. Devuelve los resultados en orden de corrida.
+std::vector<AnnealResult> run_pool(const BrushAtlas& atlas, const Canvas& C_target,
+                                   const AnnealConfig& cfg, int runs, int threads, uint32_t seed) {
+    std::vector<AnnealResult> results(runs);
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        for (int k = next++; k < runs; k = next++) {
+            seedRng(seed + (uint32_t)k);
+            results[k] = run_annealing(atlas, C_target, cfg);
+            results[k].seed = seed + (uint32_t)k;
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+    return results;
+}
+
+// Una fila por corrida y el resumen del MSE final y del tiempo
+bool write_runs_report(const std::string& logName, const std::vector<AnnealResult>& results,
+                       uint32_t seed, int threads, double wall_sec) {
+    std::ofstream logFile(logName);
+    if (!logFile.is_open()) {
+        std::cerr << "No pude escribir " << logName << "\n";
+        return false;
+    }
+    const int N = (int)results.size();
+    logFile << "Run Seed MSE_Final Time_Sec Temp_Steps Early_Exit_Rate Noop_Skips\n";
+    for (int k = 0; k < N; ++k) {
+        const AnnealResult& r = results[k];
+        logFile << k << " " << seed + (uint32_t)k << " " << r.best_cost << " " << r.seconds << " "
+                << r.temp_step << " " << (double)r.early_exits / std::max(1LL, r.total_iter) << " "
+                << r.noop_skips << "\n";
+    }
+
+    auto summary = [](std::vector<double> v, double& lo, double& med, double& hi, double& mean, double& sd) {
+        std::sort(v.begin(), v.end());
+        const size_t n = v.size();
+        lo = v.front();
+        hi = v.back();
+        med = n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+        mean = 0.0;
+        for (double x : v) mean += x;
+        mean /= n;
+        sd = 0.0;
+        for (double x : v) sd += (x - mean) * (x - mean);
+        sd = n > 1 ? std::sqrt(sd / (n - 1)) : 0.0;
+    };
+    std::vector<double> mse(N), secs(N);
+    int best = 0;
+    for (int k = 0; k < N; ++k) {
+        mse[k] = results[k].best_cost;
+        secs[k] = results[k].seconds;
+        if (mse[k] < mse[best]) best = k;
+    }
+    double lo, med, hi, mean, sd;
+    summary(mse, lo, med, hi, mean, sd);
+    logFile << "Runs Threads Best_Run Best_Seed Best_MSE Median_MSE Mean_MSE Std_MSE Max_MSE\n";
+    logFile << N << " " << threads << " " << best << " " << seed + (uint32_t)best << " "
+            << lo << " " << med << " " << mean << " " << sd << " " << hi << "\n";
+    summary(secs, lo, med, hi, mean, sd);
+    logFile << "Min_Time Median_Time Mean_Time Std_Time Max_Time Wall_Time\n";
+    logFile << lo << " " << med << " " << mean << " " << sd << " " << hi << " " << wall_sec << "\n";
+    return true;
+}
+
+// --- Main ---
+
+int main(int a, char** args) {
+    if (a < 3) {
+        std::cerr << "Uso: ./programa [nombre_imagen] [alpha] [opciones]\n"
+                  << "  --blend float|int8|int16   mezcla usada al evaluar (default int8)\n"
+                  << "  --simd auto|avx2|sse4.1|scalar   kernel del rasterizador\n"
+                  << "  --layout planar|interleaved      memoria del canvas al evaluar (default planar)\n"
+                  << "  --eval incremental|full    re-render sólo la región mutada o todo (default incremental)\n"
+                  << "  --early-exit               sortea u antes de evaluar y corta al probar el rechazo\n"
+                  << "  --screen 2|4               filtra candidatos con el objetivo reducido 2x o 4x\n"
+                  << "  --screen-margin M          margen (en MSE) del filtro (default 0)\n"
+                  << "  --cost-cache N             costos de las últimas soluciones evaluadas (default 4096, 0 = no)\n"
+                  << "  --cull                     el render completo (--eval full) descarta trazos tapados por texels opacos (los pinceles incluidos no tienen)\n"
+                  << "  --checkpoint-every K       guarda el canvas cada K trazos (0 = no, default)\n"
+                  << "  --checkpoint-mb M          memoria máxima para checkpoints (default 64)\n"
+                  << "  --check-cost N             compara el costo incremental con un render completo cada N temperaturas\n"
+                  << "  --replicas R               parallel tempering: R réplicas en hilos, con intercambios (no se combina con --screen, --cost-cache, --check-cost, --runs ni --speculate)\n"
+                  << "  --swap-target P            tasa de intercambio buscada al adaptar la escalera (default 0.23)\n"
+                  << "  --seed S                   semilla (default aleatoria, se anota en el reporte)\n"
+                  << "  --runs N                   N corridas independientes (semillas S, S+1, ...), se queda con la mejor\n"
+                  << "  --threads M                hilos para esas corridas o para --speculate (default: núcleos disponibles)\n"
+                  << "  --speculate K              evalúa K propuestas por paso en paralelo (hilos: --threads; con --eval full se pintan juntas con renderBatch en un hilo; sin --screen; con menos de ~K núcleos libres es más lento)\n"
+                  << "  --verify-simd N            compara SIMD vs escalar en N trazos y sale\n";
+        return 1;
+    }
+
+    // Opciones extra
+    AnnealConfig cfg;
+    int verify_simd = 0;
+    double checkpoint_mb = 64.0;
+    int replicas = 1;
+    bool cost_cache_given = false;
+    double swap_target = 0.23;
+    int runs = 1;
+    int threads = 0;
+    uint32_t seed = std::random_device{}();
+    CanvasLayout layout = CanvasLayout::Planar;
+    for (int k = 3; k < a; ++k) {
+        std::string opt = args[k];
+        if (opt == "--blend" && k + 1 < a) {
+            if (!parseBlendMode(args[++k], evalOpts.blend)) {
+                std::cerr << "Modo de mezcla desconocido: " << args[k] << "\n";
+                return 1;
+            }
+        } else if (opt == "--simd" && k + 1 < a) {
+            SimdLevel level;
+            if (!parseSimdLevel(args[++k], level)) {
+                std::cerr << "Nivel SIMD desconocido: " << args[k] << "\n";
+                return 1;
+            }
+            setSimdLevel(level);
+        } else if (opt == "--layout" && k + 1 < a) {
+            if (!parseCanvasLayout(args[++k], layout)) {
+                std::cerr << "Layout desconocido: " << args[k] << "\n";
+                return 1;
+            }
+        } else if (opt == "--eval" && k + 1 < a) {
+            const std::string mode = args[++k];
+            if (mode == "incremental") cfg.incremental = true;
+            else if (mode == "full") cfg.incremental = false;
+            else {
+                std::cerr << "Modo de evaluación desconocido: " << mode << "\n";
+                return 1;
+            }
+        } else if (opt == "--early-exit") {
+            cfg.early_exit = true;
+        } else if (opt == "--screen" && k + 1 < a) {
+            cfg.screen_factor = std::stoi(args[++k]);
+            if (cfg.screen_factor != 2 && cfg.screen_factor != 4) {
+                std::cerr << "Factor de filtro inválido (2 o 4): " << args[k] << "\n";
+                return 1;
+            }
+        } else if (opt == "--screen-margin" && k + 1 < a) {
+            cfg.screen_margin = std::stod(args[++k]);
+        } else if (opt == "--replicas" && k + 1 < a) {
+            replicas = std::max(1, std::stoi(args[++k]));
+        } else if (opt == "--swap-target" && k + 1 < a) {
+            swap_target = std::stod(args[++k]);
+        } else if (opt == "--seed" && k + 1 < a) {
+            seed = (uint32_t)std::stoul(args[++k]);
+        } else if (opt == "--runs" && k + 1 < a) {
+            runs = std::max(1, std::stoi(args[++k]));
+        } else if (opt == "--threads" && k + 1 < a) {
+            threads = std::max(1, std::stoi(args[++k]));
+        } else if (opt == "--speculate" && k + 1 < a) {
+            cfg.speculate = std::max(1, std::stoi(args[++k]));
+        } else if (opt == "--cost-cache" && k + 1 < a) {
+            cfg.cost_cache_size = std::max(0, std::stoi(args[++k]));
+            cost_cache_given = true;
+        } else if (opt == "--cull") {
+            cullHidden = true;
+        } else if (opt == "--checkpoint-every" && k + 1 < a) {
+            cfg.checkpoint_every = std::stoi(args[++k]);
+        } else if (opt == "--checkpoint-mb" && k + 1 < a) {
+            checkpoint_mb = std::stod(args[++k]);
+        } else if (opt == "--check-cost" && k + 1 < a) {
+            cfg.check_cost = std::stoi(args[++k]);
+        } else if (opt == "--verify-simd" && k + 1 < a) {
+            verify_simd = std::stoi(args[++k]);
+        } else {
+            std::cerr << "Opción desconocida: " << opt << "\n";
+            return 1;
+        }
+    }
+
+    if (runs > 1 && replicas > 1) {
+        std::cerr << "--runs y --replicas no se combinan\n";
+        return 1;
+    }
+    if (replicas > 1 && (cfg.screen_factor > 1 || cost_cache_given || cfg.check_cost > 0)) {
+        std::cerr << "--replicas no se combina con --screen, --cost-cache ni --check-cost\n";
+        return 1;
+    }
+    if (cfg.speculate > 1 && (runs > 1 || replicas > 1)) {
+        std::cerr << "--speculate no se combina con --runs ni --replicas\n";
+        return 1;
+    }
+    if (cfg.speculate > 1 && cfg.screen_factor > 1) {
+        std::cerr << "--speculate no se combina con --screen\n";
+        return 1;
+    }
+    cfg.checkpoint_bytes = size_t(checkpoint_mb * 1024 * 1024);
+    if (threads == 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    cfg.spec_threads = threads;
+    threads = std::min(threads, runs);
+
+    // --- 0. Configuración de Directorios y Tiempo ---
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::string imgName = args[1];
+    std::string alphaStr = args[2];
+    cfg.alpha = std::stof(alphaStr);
+
+    // Crear carpeta ./parciales/nombre_alpha
+    std::string folderPath = std::format("parciales/{}_{}", imgName, alphaStr);
+    try {
+        if (!fs::exists("parciales")) fs::create_directory("parciales");
+        if (!fs::exists(folderPath)) fs::create_directory(folderPath);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creando directorios: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::string fuente = "instancias/" + imgName + ".png";
+
+    // --- 1. Cargar Recursos ---
+    BrushAtlas atlas;
+    if (!atlas.loadDirectory("brushes")) return 1;
+
+    if (verify_simd > 0) {
+        const long long diffs = verifySimdKernels(atlas, verify_simd, 12345u);
+        std::cout << "Verificación SIMD (" << simdLevelName(strokeKernels().level) << " vs scalar): "
+                  << verify_simd << " trazos, " << diffs << " bytes distintos\n";
+        return diffs == 0 ? 0 : 1;
+    }
+
+    Canvas C_target(0, 0);
+    if (!loadImageRGB_asCanvas(fuente, C_target, layout)) {
+        std::cerr << "Error cargando fuente.\n";
+        return 1;
+    }
+
+    // --- 2-4. SA: una cadena, parallel tempering o varias corridas ---
+    std::cout << "Semilla: " << seed << "\n";
+    AnnealResult res;
+    if (replicas > 1) {
+        TemperingConfig tcfg;
+        tcfg.replicas = replicas;
+        tcfg.swap_target = swap_target;
+        tcfg.seed = seed;
+        res = run_tempering(atlas, C_target, cfg, tcfg);
+        res.seed = seed;
+    } else if (runs > 1) {
+        cfg.verbose = false;
+        const std::vector<AnnealResult> results = run_pool(atlas, C_target, cfg, runs, threads, seed);
+        const double wall = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+        write_runs_report(std::format("{}/corridas.txt", folderPath), results, seed, threads, wall);
+        int best = 0;
+        for (int k = 0; k < runs; ++k) {
+            std::cout << "Corrida " << k << " (semilla " << seed + (uint32_t)k << "): MSE "
+                      << results[k].best_cost << " en " << results[k].seconds << "s\n";
+            if (results[k].best_cost < results[best].best_cost) best = k;
+        }
+        res = results[best];
+    } else {
+        seedRng(seed);
+        cfg.partials_folder = folderPath;
+        res = run_annealing(atlas, C_target, cfg);
+        res.seed = seed;
+    }
+
     // --- 5. Finalización y Reporte ---
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = end_time - start_time;
     double duration_sec = diff.count();
 
-    std::cout << "Terminado en " << duration_sec << "s. MSE Final: " << costo_mejor << "\n";
-
-    // Guardar imagen final
-    Canvas C_final(C_target.width, C_target.height);
-    render(sol_mejor, C_final);
+    // Guardar imagen final. Se pinta con el camino exacto en float, no con
+    // el de evaluación (int8, rotación cuantizada), así que su MSE difiere
+    // un poco del costo optimizado y se informa aparte
+    Canvas C_final(C_target.width, C_target.height, C_target.layout);
+    render(atlas, res.best, C_final);
+    const double final_mse = canvas_mse(C_final, C_target);
     savePNG(C_final, std::format("{}/FINAL.png", folderPath));
 
-    // Guardar LOG .txt
-    std::string logName = std::format("{}/reporte.txt", folderPath);
-    std::ofstream logFile(logName);
-    if (logFile.is_open()) {
-        // Primera fila: Encabezados de contadores + Tiempo
-        logFile << "Mut_X Mut_Y Mut_Size Mut_Rot Mut_R Mut_G Mut_B Mut_Type Time_Sec\n";
-        
-        // Segunda fila: Datos de contadores + Tiempo
-        for(int k=0; k<8; ++k) logFile << stats.accepted_mutations[k] << " ";
-        logFile << duration_sec << "\n";
-
-        // %
-        for(int k=0; k<8; ++k) logFile << stats.accepted_mutations[k]/total_iter << " ";
-        logFile << duration_sec << "\n";
-
-        logFile << "--- Historial MSE por cambio de temperatura ---\n";
-        for (double val : stats.mse_history) {
-            logFile << val << "\n";
-        }
-        logFile.close();
-    }
+    std::cout << "Terminado en " << duration_sec << "s. MSE Final: " << res.best_cost
+              << " (FINAL.png: " << final_mse << ")\n";
+
+    // Guardar LOG .txt (de la mejor corrida si hay varias, con su tiempo)
+    write_report(std::format("{}/reporte.txt", folderPath), res, cfg, atlas, C_target,
+                 runs > 1 ? res.seconds : duration_sec, final_mse);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,136 @@
+#include "brush_atlas.h"
+#include "stroke.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+static constexpr size_t kAlign = 64;
+
+static size_t alignUp(size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+const BrushLevel& BrushInfo::levelFor(int base) const {
+    const BrushLevel* best = &levels[0];
+    for (size_t i = 1; i < levels.size(); ++i) {
+        if (std::max(levels[i].width, levels[i].height) < base) break;
+        best = &levels[i];
+    }
+    return *best;
+}
+
+BrushAtlas::BrushAtlas() {
+    static std::atomic<uint32_t> next_id{1};
+    atlas_id = next_id++;
+}
+
+// Orden de los archivos: primero los de nombre numérico, en orden numérico
+// ("2" < "10"), luego el resto por nombre. La clave es una sola tupla
+// (no numérico, largo si es numérico, nombre), así el orden es estricto.
+static bool brushNameLess(const fs::path& a, const fs::path& b) {
+    auto key = [](const fs::path& p) {
+        const std::string stem = p.stem().string();
+        const bool numeric = !stem.empty()
+            && std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; });
+        return std::make_tuple(!numeric, numeric ? stem.size() : size_t(0), p.filename().string());
+    };
+    return key(a) < key(b);
+}
+
+bool BrushAtlas::loadDirectory(const std::string& dir) {
+    std::vector<fs::path> files;
+    try {
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            if (!entry.is_regular_file()) continue;
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (ext == ".jpg" || ext == ".jpeg" || ext == ".png") files.push_back(entry.path());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "BrushAtlas: no pude leer " << dir << ": " << e.what() << "\n";
+        return false;
+    }
+    if (files.empty()) {
+        std::cerr << "BrushAtlas: no hay brushes en " << dir << "\n";
+        return false;
+    }
+    std::sort(files.begin(), files.end(), brushNameLess);
+
+    std::vector<ImageGray> images(files.size());
+    std::vector<std::string> names;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!loadImageGray(files[i].string(), images[i])) return false;
+        names.push_back(files[i].filename().string());
+    }
+    build(images, names);
+    return true;
+}
+
+void BrushAtlas::build(const std::vector<ImageGray>& images, const std::vector<std::string>& names) {
+    // Niveles de cada imagen: el original y luego su pirámide
+    auto levelsOf = [](const ImageGray& img) {
+        std::vector<const ImageGray*> lv{&img};
+        for (const auto& m : img.mips) lv.push_back(&m);
+        return lv;
+    };
+
+    // 1) Tamaño total: texels + tramos de cada nivel, cada uno alineado a 64
+    size_t total = 0;
+    for (const auto& img : images) {
+        for (const ImageGray* lv : levelsOf(img)) {
+            total += alignUp(size_t(lv->width) * lv->height);
+            total += 2 * alignUp(sizeof(int) * lv->height);
+        }
+    }
+    block.reset(static_cast<uint8_t*>(std::aligned_alloc(kAlign, std::max(total, kAlign))));
+    block_bytes = total;
+
+    // 2) Copiar al bloque y armar las vistas
+    brushes.clear();
+    brushes.resize(images.size());
+    uint8_t* cur = block.get();
+    for (size_t i = 0; i < images.size(); ++i) {
+        const ImageGray& img = images[i];
+        BrushInfo& info = brushes[i];
+        info.name = i < names.size() ? names[i] : std::to_string(i);
+        info.width = img.width;
+        info.height = img.height;
+        info.bbox_x0 = img.bbox_x0;
+        info.bbox_y0 = img.bbox_y0;
+        info.bbox_x1 = img.bbox_x1;
+        info.bbox_y1 = img.bbox_y1;
+
+        uint64_t sum = 0;
+        for (size_t k = 0; k < size_t(img.width) * img.height; ++k) sum += img.data[k];
+        info.coverage = sum / 255.0;
+
+        for (const ImageGray* lv : levelsOf(img)) {
+            BrushLevel L;
+            L.width = lv->width;
+            L.height = lv->height;
+            L.bbox_x0 = lv->bbox_x0;
+            L.bbox_y0 = lv->bbox_y0;
+            L.bbox_x1 = lv->bbox_x1;
+            L.bbox_y1 = lv->bbox_y1;
+
+            const size_t n = size_t(lv->width) * lv->height;
+            std::memcpy(cur, lv->data.data(), n);
+            L.data = cur;
+            cur += alignUp(n);
+
+            int* sx0 = reinterpret_cast<int*>(cur);
+            std::memcpy(sx0, lv->span_x0.data(), sizeof(int) * lv->height);
+            cur += alignUp(sizeof(int) * lv->height);
+            int* sx1 = reinterpret_cast<int*>(cur);
+            std::memcpy(sx1, lv->span_x1.data(), sizeof(int) * lv->height);
+            cur += alignUp(sizeof(int) * lv->height);
+            L.span_x0 = sx0;
+            L.span_x1 = sx1;
+
+            info.levels.push_back(L);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef BRUSH_ATLAS_H
+#define BRUSH_ATLAS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ================= BrushAtlas =================
+// Todos los brushes de una carpeta (con su pirámide mip y su índice de
+// tramos no nulos) empaquetados en un único bloque alineado a 64 bytes.
+// Es de sólo lectura una vez cargado: varios pintores pueden compartirlo.
+
+// Vista de un nivel (original o mip) dentro del bloque del atlas
+struct BrushLevel {
+    int width = 0, height = 0;
+    const uint8_t* data = nullptr;   // width*height texels (alpha)
+    const int* span_x0 = nullptr;    // tramo no nulo [span_x0[y], span_x1[y])
+    const int* span_x1 = nullptr;
+    int bbox_x0 = 0, bbox_y0 = 0, bbox_x1 = 0, bbox_y1 = 0;
+
+    bool emptyAlpha() const { return bbox_x0 >= bbox_x1 || bbox_y0 >= bbox_y1; }
+};
+
+// Metadatos de un brush
+struct BrushInfo {
+    std::string name;                // archivo de origen
+    int width = 0, height = 0;
+    int bbox_x0 = 0, bbox_y0 = 0, bbox_x1 = 0, bbox_y1 = 0; // alpha no nulo (nivel 0)
+    double coverage = 0.0;           // suma del alpha en [0,1] del nivel 0
+    std::vector<BrushLevel> levels;  // levels[0] = original, luego la pirámide
+
+    // Nivel más pequeño cuyo lado mayor sigue cubriendo 'base' píxeles
+    const BrushLevel& levelFor(int base) const;
+};
+
+struct ImageGray;
+
+class BrushAtlas {
+public:
+    BrushAtlas();
+
+    // Carga todas las imágenes (.jpg/.jpeg/.png) de 'dir', ordenadas por
+    // nombre (los nombres numéricos en orden numérico): el tipo i del
+    // stroke es el i-ésimo archivo.
+    bool loadDirectory(const std::string& dir);
+
+    // Empaqueta imágenes ya cargadas (con mips e índice construidos)
+    void build(const std::vector<ImageGray>& images, const std::vector<std::string>& names);
+
+    int size() const { return (int)brushes.size(); }
+    bool empty() const { return brushes.empty(); }
+    const BrushInfo& operator[](int i) const { return brushes[i]; }
+
+    uint32_t id() const { return atlas_id; }    // distingue atlas en las cachés
+    size_t bytes() const { return block_bytes; } // tamaño del bloque contiguo
+
+private:
+    struct FreeDeleter { void operator()(void* p) const { std::free(p); } };
+
+    std::unique_ptr<uint8_t, FreeDeleter> block;
+    size_t block_bytes = 0;
+    std::vector<BrushInfo> brushes;
+    uint32_t atlas_id = 0;
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "evaluator.h"
+#include "stroke_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+uint64_t regionSSE(const Canvas& A, const Canvas& B, const Rect& r) {
+    if (r.empty()) return 0;
+    const auto sse8 = strokeKernels().sse8;
+    uint64_t sse = 0;
+    if (A.planar()) {
+        for (int c = 0; c < 3; ++c) {
+            for (int y = r.y0; y < r.y1; ++y) {
+                const size_t off = size_t(y) * A.stride + r.x0;
+                sse += sse8(A.plane(c) + off, B.plane(c) + off, r.x1 - r.x0);
+            }
+        }
+        return sse;
+    }
+    for (int y = r.y0; y < r.y1; ++y) {
+        const size_t off = (size_t(y) * A.width + r.x0) * 3;
+        sse += sse8(A.rgb.data() + off, B.rgb.data() + off, (r.x1 - r.x0) * 3);
+    }
+    return sse;
+}
+
+// Pinta 'r' de blanco (el fondo de render)
+static void clearRegion(Canvas& C, const Rect& r) {
+    if (C.planar()) {
+        for (int c = 0; c < 3; ++c)
+            for (int y = r.y0; y < r.y1; ++y)
+                std::memset(C.plane(c) + size_t(y) * C.stride + r.x0, 255, r.x1 - r.x0);
+        return;
+    }
+    for (int y = r.y0; y < r.y1; ++y)
+        std::memset(&C.rgb[(size_t(y) * C.width + r.x0) * 3], 255, size_t(r.x1 - r.x0) * 3);
+}
+
+// Copia la región 'r' de src a dst
+static void copyRegion(const Canvas& src, Canvas& dst, const Rect& r) {
+    if (src.planar()) {
+        for (int c = 0; c < 3; ++c)
+            for (int y = r.y0; y < r.y1; ++y) {
+                const size_t off = size_t(y) * src.stride + r.x0;
+                std::memcpy(dst.plane(c) + off, src.plane(c) + off, r.x1 - r.x0);
+            }
+        return;
+    }
+    for (int y = r.y0; y < r.y1; ++y) {
+        const size_t off = (size_t(y) * src.width + r.x0) * 3;
+        std::memcpy(&dst.rgb[off], &src.rgb[off], size_t(r.x1 - r.x0) * 3);
+    }
+}
+
+IncrementalEvaluator::IncrementalEvaluator(const BrushAtlas& atlas_, const Canvas& target_,
+                                           const RenderOptions& opt_, int tile_size)
+    : atlas(atlas_), target(target_), opt(opt_),
+      current(target_.width, target_.height, target_.layout), tile(std::max(1, tile_size)) {
+    scratch.canvas = Canvas(target.width, target.height, target.layout);
+    tiles_x = (target.width + tile - 1) / tile;
+    tiles_y = (target.height + tile - 1) / tile;
+    scratch.tiles.reserve(size_t(tiles_x) * tiles_y);
+}
+
+Rect IncrementalEvaluator::tileRect(int tx, int ty) const {
+    return { tx * tile, ty * tile, std::min(target.width, (tx + 1) * tile),
+             std::min(target.height, (ty + 1) * tile) };
+}
+
+void IncrementalEvaluator::computeTiles(const Canvas& C, std::vector<uint64_t>& out) const {
+    out.assign(size_t(tiles_x) * tiles_y, 0);
+    for (int ty = 0; ty < tiles_y; ++ty)
+        for (int tx = 0; tx < tiles_x; ++tx)
+            out[size_t(ty) * tiles_x + tx] = regionSSE(C, target, tileRect(tx, ty));
+}
+
+double IncrementalEvaluator::mseOf(uint64_t sse) const {
+    const size_t num_pixels = size_t(target.width) * target.height;
+    if (num_pixels == 0) return std::numeric_limits<double>::max();
+    return (double)sse / (double)(num_pixels * 3);
+}
+
+void IncrementalEvaluator::setCheckpoints(int every, size_t max_bytes) {
+    ck_every = std::max(0, every);
+    ck_max_bytes = max_bytes;
+}
+
+double IncrementalEvaluator::reset(const std::vector<Stroke>& solution) {
+    strokes.reset(atlas, target.width, target.height, opt, solution);
+    index.build(target.width, target.height, tile, strokes.bbox);
+
+    // Checkpoints: tras ck_step, 2*ck_step, ... trazos (el último estado es
+    // el canvas actual, no se guarda aparte)
+    checkpoints.clear();
+    ck_step = 0;
+    const int N = strokes.size();
+    if (ck_every > 0 && N > ck_every) {
+        const size_t canvas_bytes = std::max<size_t>(1, current.rgb.size());
+        const int max_count = (int)std::min<size_t>(N, ck_max_bytes / canvas_bytes);
+        if (max_count > 0) {
+            ck_step = std::max(ck_every, (N - 1) / max_count + 1);
+            if (ck_step >= N) ck_step = 0;
+        }
+    }
+
+    current.clear(255, 255, 255);
+    for (int j = 0; j < N; ++j) {
+        if (ck_step > 0 && j > 0 && j % ck_step == 0) checkpoints.push_back(current);
+        strokes.draw(j, current);
+    }
+    computeTiles(current, tile_sse);
+    cur_sse = 0;
+    for (uint64_t t : tile_sse) cur_sse += t;
+    return cost();
+}
+
+int IncrementalEvaluator::composeRegion(Canvas& dst, const Rect& r, int from, int to,
+                                        int idx, const Stroke& cand, const Rect& cand_rect,
+                                        std::vector<int>& ids) const {
+    // El trazo 'idx' se pinta en su lugar con la caja nueva, esté o no su
+    // caja vieja en la consulta
+    int drawn = 0;
+    bool cand_done = idx < from || idx >= to;
+    auto drawCand = [&] {
+        cand_done = true;
+        if (cand_rect.intersects(r)) { cand.draw(atlas, dst, r, opt); ++drawn; }
+    };
+    index.query(r, ids);
+    for (int j : ids) {
+        if (j < from) continue;
+        if (j >= to) break;
+        if (!cand_done && idx <= j) drawCand();
+        if (j == idx) continue;
+        strokes.draw(j, dst, r);
+        ++drawn;
+    }
+    if (!cand_done) drawCand();
+    return drawn;
+}
+
+double IncrementalEvaluator::evaluate(int idx, const Stroke& candidate, Scratch& s,
+                                      double reject_delta) const {
+    evaluations.fetch_add(1, std::memory_order_relaxed);
+    if (s.canvas.width != target.width || s.canvas.height != target.height
+        || s.canvas.layout != target.layout) {
+        s.canvas = Canvas(target.width, target.height, target.layout);
+        s.tiles.reserve(size_t(tiles_x) * tiles_y); // la región nunca toca más tiles
+    }
+
+    s.idx = idx;
+    s.stroke = candidate;
+    strokes.place(candidate, s.geom);
+    s.rect = s.geom.bbox;
+    s.dirty = index.rect(idx).united(s.rect);
+    s.sse = cur_sse;
+    s.tiles.clear();
+    if (s.dirty.empty()) return mseOf(s.sse);
+    dirty_pixels.fetch_add(s.dirty.area(), std::memory_order_relaxed);
+
+    // Aporte viejo de cada tile que toca la región. Si la región lo cubre
+    // entero, es la suma guardada del tile.
+    const int tx0 = s.dirty.x0 / tile, tx1 = (s.dirty.x1 - 1) / tile;
+    const int ty0 = s.dirty.y0 / tile, ty1 = (s.dirty.y1 - 1) / tile;
+    uint64_t old_total = 0;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            const int i = ty * tiles_x + tx;
+            const Rect t = tileRect(tx, ty);
+            const Rect d = t.intersected(s.dirty);
+            const uint64_t old_part = (d == t) ? tile_sse[i] : regionSSE(current, target, d);
+            s.tiles.emplace_back(i, old_part);
+            old_total += old_part;
+        }
+    }
+    const uint64_t outside = cur_sse - old_total; // SSE fuera de la región
+
+    // Recomponer la región: desde el checkpoint más cercano bajo 'idx' (o
+    // el fondo), luego los trazos que la tocan, en orden. Con cota se hace
+    // por franjas de una fila de tiles, primero las que pinta el trazo
+    // nuevo: en cuanto la suma parcial supera la cota, se descarta.
+    const int c = ck_step > 0 ? std::min(idx / ck_step, (int)checkpoints.size()) : 0;
+    const bool bounded = reject_delta < std::numeric_limits<double>::infinity();
+    const double cur_cost = cost();
+    uint64_t new_total = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            Rect band = s.dirty;
+            if (bounded) {
+                band = band.intersected(Rect{0, ty * tile, target.width, (ty + 1) * tile});
+                if (band.intersects(s.rect) != (pass == 0)) continue;
+            } else if (pass > 0 || ty > ty0) {
+                break; // sin cota: toda la región de una vez
+            }
+
+            if (c > 0) copyRegion(checkpoints[c - 1], s.canvas, band);
+            else       clearRegion(s.canvas, band);
+            const int drawn = composeRegion(s.canvas, band, c * ck_step, strokes.size(),
+                                            idx, candidate, s.rect, s.ids);
+            strokes_drawn.fetch_add(drawn, std::memory_order_relaxed);
+
+            // Tiles de la franja (o de toda la región)
+            const int by0 = bounded ? ty : ty0, by1 = bounded ? ty : ty1;
+            for (int by = by0; by <= by1; ++by) {
+                for (int tx = tx0; tx <= tx1; ++tx) {
+                    auto& [i, part] = s.tiles[size_t(by - ty0) * (tx1 - tx0 + 1) + (tx - tx0)];
+                    const uint64_t new_part = regionSSE(s.canvas, target, tileRect(tx, by).intersected(s.dirty));
+                    part = tile_sse[i] - part + new_part; // ahora: SSE nuevo del tile
+                    new_total += new_part;
+                }
+            }
+            if (bounded && mseOf(outside + new_total) - cur_cost >= reject_delta) {
+                s.idx = -1; // no se puede aceptar
+                return std::numeric_limits<double>::infinity();
+            }
+        }
+    }
+    s.sse = outside + new_total;
+    return mseOf(s.sse);
+}
+
+void IncrementalEvaluator::accept(const Scratch& s) {
+    if (s.idx < 0) return;
+
+    strokes.set(s.idx, s.stroke, s.geom);
+    index.update(s.idx, s.rect);
+    if (!s.dirty.empty()) {
+        copyRegion(s.canvas, current, s.dirty);
+
+        // Los checkpoints por encima del trazo cambiado quedan viejos en la
+        // región: se rehacen en orden, cada uno desde el anterior
+        const int first = ck_step > 0 ? s.idx / ck_step : (int)checkpoints.size();
+        for (int m = first; m < (int)checkpoints.size(); ++m) {
+            if (m > 0) copyRegion(checkpoints[m - 1], checkpoints[m], s.dirty);
+            else       clearRegion(checkpoints[m], s.dirty);
+            composeRegion(checkpoints[m], s.dirty, m * ck_step, (m + 1) * ck_step,
+                          -1, s.stroke, s.rect, accept_ids);
+        }
+    }
+    for (const auto& [i, t] : s.tiles) tile_sse[i] = t;
+    cur_sse = s.sse;
+}
+
+int IncrementalEvaluator::crossCheck() const {
+    // Con Stroke::draw, así también se verifica la geometría guardada
+    const std::vector<Stroke> sol = strokes.strokes();
+    Canvas full(target.width, target.height, target.layout);
+    render(atlas, sol, full, opt);
+    std::vector<uint64_t> tiles;
+    computeTiles(full, tiles);
+    uint64_t total = 0;
+    for (uint64_t t : tiles) total += t;
+
+    int bad = 0;
+    if (full.rgb != current.rgb) {
+        std::cerr << "crossCheck: el canvas incremental difiere del render completo\n";
+        ++bad;
+    }
+    for (size_t m = 0; m < checkpoints.size(); ++m) {
+        Canvas part(target.width, target.height, target.layout);
+        render(atlas, std::vector<Stroke>(sol.begin(), sol.begin() + (m + 1) * ck_step), part, opt);
+        if (part.rgb != checkpoints[m].rgb) {
+            std::cerr << "crossCheck: el checkpoint " << m << " difiere del render completo\n";
+            ++bad;
+        }
+    }
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (tiles[i] != tile_sse[i]) {
+            std::cerr << "crossCheck: tile " << i << " SSE " << tile_sse[i] << " != " << tiles[i] << "\n";
+            ++bad;
+        }
+    }
+    if (total != cur_sse) {
+        std::cerr << "crossCheck: SSE total " << cur_sse << " != " << total << "\n";
+        ++bad;
+    }
+    return bad;
+}
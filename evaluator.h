@@ -0,0 +1,120 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "stroke.h"
+#include "stroke_index.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// ================= Evaluador incremental =================
+// Mantiene el canvas de la solución actual y su SSE contra el objetivo.
+// Una propuesta (un trazo reemplazado) sólo recompone la unión de la caja
+// vieja y la nueva del trazo: se pinta el fondo en esa región y se
+// redibujan, en orden y recortados a ella, los trazos que la tocan (que se
+// buscan en un índice espacial de sus cajas).
+// El error se guarda como una suma entera por tile (tile x tile píxeles):
+// el costo de una propuesta ajusta sólo los tiles que toca la región, y los
+// tiles que la región cubre entera no se vuelven a leer del canvas actual.
+// Opcionalmente guarda checkpoints: el canvas tras cada 'every' trazos. Una
+// propuesta sobre el trazo i arranca desde el checkpoint más cercano por
+// debajo de i en vez del fondo blanco.
+// El MSE resultante es idéntico al de renderizar todo de nuevo.
+class IncrementalEvaluator {
+public:
+    // Región recompuesta de una propuesta. evaluate() sólo lee el estado
+    // actual (salvo las estadísticas, que son atómicas), así que varios
+    // hilos pueden evaluar a la vez, cada uno con su propio Scratch.
+    struct Scratch {
+        Canvas canvas{0, 0};
+        Rect dirty;          // región recompuesta
+        uint64_t sse = 0;    // SSE total de la solución propuesta
+        int idx = -1;        // trazo reemplazado
+        Stroke stroke;
+        StrokeGeometry geom; // geometría del trazo nuevo
+        Rect rect;           // caja del trazo nuevo
+        std::vector<std::pair<int, uint64_t>> tiles; // (tile, SSE nuevo) tocados
+        std::vector<int> ids;                        // trazos que tocan 'dirty'
+    };
+
+    IncrementalEvaluator(const BrushAtlas& atlas, const Canvas& target, const RenderOptions& opt,
+                         int tile_size = 16);
+
+    // Checkpoint cada 'every' trazos (0 = sin checkpoints), usando a lo sumo
+    // max_bytes de memoria: si no alcanza, se espacian más. Tiene efecto en
+    // el próximo reset().
+    void setCheckpoints(int every, size_t max_bytes);
+    int checkpointStep() const { return ck_step; }
+    int checkpointCount() const { return (int)checkpoints.size(); }
+
+    // Render completo de 'solution'; devuelve su MSE
+    double reset(const std::vector<Stroke>& solution);
+
+    // MSE de la solución actual con el trazo 'idx' reemplazado por 'candidate'.
+    // Si el aumento del costo llega a 'reject_delta', corta antes y devuelve
+    // infinito (la propuesta no puede aceptarse).
+    double evaluate(int idx, const Stroke& candidate, Scratch& s,
+                    double reject_delta = std::numeric_limits<double>::infinity()) const;
+    double propose(int idx, const Stroke& candidate,
+                   double reject_delta = std::numeric_limits<double>::infinity()) {
+        return evaluate(idx, candidate, scratch, reject_delta);
+    }
+
+    // Acepta la propuesta: la región sucia pasa al canvas actual.
+    // Rechazar es no hacer nada (la región del scratch se descarta).
+    void accept(const Scratch& s);
+    void accept() { accept(scratch); }
+
+    double cost() const { return mseOf(cur_sse); }
+    uint64_t sse() const { return cur_sse; }
+    double mseOf(uint64_t sse) const;
+    std::vector<Stroke> solution() const { return strokes.strokes(); }
+    const Canvas& canvas() const { return current; }
+
+    // Depuración: re-renderiza todo y compara canvas, tiles y total con el
+    // estado incremental. Devuelve la cantidad de diferencias (0 = ok).
+    int crossCheck() const;
+
+    // Estadísticas (atómicas: evaluate() puede correr en varios hilos)
+    mutable std::atomic<long long> evaluations{0};
+    mutable std::atomic<long long> dirty_pixels{0};   // píxeles recompuestos en total
+    mutable std::atomic<long long> strokes_drawn{0};  // trazos redibujados al evaluar
+
+private:
+    const BrushAtlas& atlas;
+    const Canvas& target;
+    RenderOptions opt;
+
+    StrokeSet strokes;         // solución actual con su geometría
+    StrokeIndex index;         // caja de cada trazo de la solución actual
+    std::vector<int> accept_ids;
+    Canvas current;
+    uint64_t cur_sse = 0;
+
+    int tile, tiles_x = 0, tiles_y = 0;
+    std::vector<uint64_t> tile_sse;  // SSE de cada tile, fila por fila
+
+    Scratch scratch;
+
+    int ck_every = 0;
+    size_t ck_max_bytes = 0;
+    int ck_step = 0;                  // trazos entre checkpoints (0 = ninguno)
+    std::vector<Canvas> checkpoints;  // checkpoints[m] = tras (m+1)*ck_step trazos
+
+    // Pinta en 'dst', recortados a 'r', los trazos [from,to) que la tocan,
+    // con el trazo 'idx' reemplazado por 'cand' (caja 'cand_rect').
+    // Devuelve cuántos pintó.
+    int composeRegion(Canvas& dst, const Rect& r, int from, int to,
+                      int idx, const Stroke& cand, const Rect& cand_rect,
+                      std::vector<int>& ids) const;
+    Rect tileRect(int tx, int ty) const;
+    void computeTiles(const Canvas& C, std::vector<uint64_t>& out) const;
+};
+
+// Suma de cuadrados de las diferencias de A y B dentro de 'r' (mismo
+// tamaño y layout)
+uint64_t regionSSE(const Canvas& A, const Canvas& B, const Rect& r);
+
+#endif
@@ -1,5 +1,7 @@
 #include "stroke.h"
+#include "stroke_simd.h"
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -11,13 +13,22 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-std::vector<ImageGray> gBrushes;  // definición del vector global
-
 // Canvas
 
-Canvas::Canvas(int w, int h) : width(w), height(h), rgb(w*h*3, 255) {} // arranca blanco
+Canvas::Canvas(int w, int h, CanvasLayout l) : width(w), height(h), layout(l) {
+    stride = planar() ? (w + 63) / 64 * 64 : w * 3;
+    rgb.assign(planar() ? size_t(stride) * h * 3 : size_t(w) * h * 3, 255); // arranca blanco
+}
 
 void Canvas::clear(uint8_t r, uint8_t g, uint8_t b) {
+    if (planar()) {
+        // Cada plano es contiguo: el relleno de las filas también se pinta
+        const size_t n = size_t(stride) * height;
+        std::fill_n(plane(0), n, r);
+        std::fill_n(plane(1), n, g);
+        std::fill_n(plane(2), n, b);
+        return;
+    }
     const int N = width * height;
     for (int i = 0; i < N; i++) {
         rgb[i*3 + 0] = r;
@@ -28,12 +39,67 @@ void Canvas::clear(uint8_t r, uint8_t g, uint8_t b) {
 
 void Canvas::setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
     if (x < 0 || y < 0 || x >= width || y >= height) return;
+    if (planar()) {
+        const size_t idx = size_t(y) * stride + x;
+        plane(0)[idx] = r;
+        plane(1)[idx] = g;
+        plane(2)[idx] = b;
+        return;
+    }
     const int idx = (y * width + x) * 3;
     rgb[idx + 0] = r;
     rgb[idx + 1] = g;
     rgb[idx + 2] = b;
 }
 
+Canvas Canvas::toLayout(CanvasLayout l) const {
+    if (l == layout) return *this;
+    Canvas out(width, height, l);
+    const Canvas& P = planar() ? *this : out;  // el planar
+    const Canvas& I = planar() ? out : *this;  // el interleaved
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const size_t pi = size_t(y) * P.stride + x;
+            const size_t ii = (size_t(y) * width + x) * 3;
+            for (int c = 0; c < 3; ++c) {
+                if (planar()) out.rgb[ii + c] = P.plane(c)[pi];
+                else          out.plane(c)[pi] = I.rgb[ii + c];
+            }
+        }
+    }
+    return out;
+}
+
+Canvas Canvas::downsample(int f) const {
+    f = std::max(1, f);
+    Canvas out((width + f - 1) / f, (height + f - 1) / f, layout);
+    for (int oy = 0; oy < out.height; ++oy) {
+        for (int ox = 0; ox < out.width; ++ox) {
+            const int x1 = std::min(width, (ox + 1) * f), y1 = std::min(height, (oy + 1) * f);
+            const int n = (x1 - ox * f) * (y1 - oy * f);
+            int sum[3] = {0, 0, 0};
+            for (int y = oy * f; y < y1; ++y) {
+                for (int x = ox * f; x < x1; ++x) {
+                    for (int c = 0; c < 3; ++c) {
+                        sum[c] += planar() ? plane(c)[size_t(y) * stride + x]
+                                           : rgb[(size_t(y) * width + x) * 3 + c];
+                    }
+                }
+            }
+            out.setPixel(ox, oy, uint8_t((sum[0] + n / 2) / n), uint8_t((sum[1] + n / 2) / n),
+                         uint8_t((sum[2] + n / 2) / n));
+        }
+    }
+    return out;
+}
+
+bool parseCanvasLayout(const std::string& name, CanvasLayout& out) {
+    if (name == "planar") out = CanvasLayout::Planar;
+    else if (name == "interleaved") out = CanvasLayout::Interleaved;
+    else return false;
+    return true;
+}
+
 // Helper para cargar los brushes
 
 bool loadImageGray(const std::string& filename, ImageGray& out) {
@@ -47,12 +113,67 @@ bool loadImageGray(const std::string& filename, ImageGray& out) {
     out.height = h;
     out.data.assign(data, data + (w*h));
     stbi_image_free(data);
+    buildMips(out);
     return true;
 }
 
+// Pirámide mip: cada nivel promedia bloques 2x2 del anterior (los bordes
+// impares se replican), así 'draw' muestrea una máscara del tamaño del trazo
+// en vez de los 300x300 originales.
+void buildMips(ImageGray& img) {
+    img.mips.clear();
+    const ImageGray* prev = &img;
+    while (prev->width > 1 || prev->height > 1) {
+        ImageGray lvl;
+        lvl.width  = (prev->width  + 1) / 2;
+        lvl.height = (prev->height + 1) / 2;
+        lvl.data.resize(lvl.width * lvl.height);
+        for (int y = 0; y < lvl.height; ++y) {
+            const int y0 = 2 * y;
+            const int y1 = std::min(y0 + 1, prev->height - 1);
+            for (int x = 0; x < lvl.width; ++x) {
+                const int x0 = 2 * x;
+                const int x1 = std::min(x0 + 1, prev->width - 1);
+                const int sum = prev->data[y0 * prev->width + x0] + prev->data[y0 * prev->width + x1]
+                              + prev->data[y1 * prev->width + x0] + prev->data[y1 * prev->width + x1];
+                lvl.data[y * lvl.width + x] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+        img.mips.push_back(std::move(lvl));
+        prev = &img.mips.back();
+    }
+
+    buildSpanIndex(img);
+    for (auto& lvl : img.mips) buildSpanIndex(lvl);
+}
+
+// Índice de tramos no nulos por fila + caja ajustada del alpha
+void buildSpanIndex(ImageGray& img) {
+    img.span_x0.assign(img.height, 0);
+    img.span_x1.assign(img.height, 0);
+    img.bbox_x0 = img.width;
+    img.bbox_y0 = img.height;
+    img.bbox_x1 = img.bbox_y1 = 0;
+    for (int y = 0; y < img.height; ++y) {
+        const uint8_t* row = &img.data[y * img.width];
+        int x0 = 0, x1 = img.width;
+        while (x0 < x1 && row[x0] == 0) ++x0;
+        while (x1 > x0 && row[x1 - 1] == 0) --x1;
+        if (x0 == x1) continue;
+        img.span_x0[y] = x0;
+        img.span_x1[y] = x1;
+        img.bbox_x0 = std::min(img.bbox_x0, x0);
+        img.bbox_x1 = std::max(img.bbox_x1, x1);
+        img.bbox_y0 = std::min(img.bbox_y0, y);
+        img.bbox_y1 = y + 1;
+    }
+    if (img.bbox_x0 >= img.bbox_x1) img.bbox_x0 = img.bbox_y0 = 0;
+}
+
 // Helpers para guardar la imagen final
 
 bool savePNG(const Canvas& C, const std::string& filename) {
+    if (C.planar()) return savePNG(C.toLayout(CanvasLayout::Interleaved), filename);
     const int stride = C.width * 3;
     if (!stbi_write_png(filename.c_str(), C.width, C.height, 3,
                         C.rgb.data(), stride)) {
@@ -64,12 +185,13 @@ bool savePNG(const Canvas& C, const std::string& filename) {
 
 // Helpers para comparar lienzos
 
-void render(const std::vector<Stroke>& strokes, Canvas& C) {
+void render(const BrushAtlas& atlas, const std::vector<Stroke>& strokes, Canvas& C,
+            const RenderOptions& opt) {
     C.clear(255, 255, 255); // fondo blanco
-    for (const auto& s : strokes) s.draw(C);
+    for (const auto& s : strokes) s.draw(atlas, C, opt);
 }
 
-bool loadImageRGB_asCanvas(const std::string& filename, Canvas& out) {
+bool loadImageRGB_asCanvas(const std::string& filename, Canvas& out, CanvasLayout layout) {
     int w, h, n;
     unsigned char* data = stbi_load(filename.c_str(), &w, &h, &n, 3);
     if (!data) {
@@ -79,6 +201,7 @@ bool loadImageRGB_asCanvas(const std::string& filename, Canvas& out) {
     out = Canvas(w, h);
     out.rgb.assign(data, data + (w*h*3));
     stbi_image_free(data);
+    if (layout != CanvasLayout::Interleaved) out = out.toLayout(layout);
     return true;
 }
 
@@ -94,120 +217,784 @@ static inline T clampT(T v, T lo, T hi) {
     return (v < lo) ? lo : (v > hi) ? hi : v;
 }
 
-void Stroke::draw(Canvas& C) const {
-    // --- Validaciones básicas ---
-    if (gBrushes.empty()) return;
-    if (type < 0 || type >= (int)gBrushes.size()) return;
+// Caché de huellas
+
+FootprintCache::FootprintCache(int capacity) { setCapacity(capacity); }
+
+void FootprintCache::setCapacity(int capacity) {
+    capacity = std::max(1, capacity);
+    size_t tsize = 1;
+    while (tsize < size_t(capacity) * 2) tsize <<= 1;
+    entries.assign(capacity, Entry());
+    table.assign(tsize, -1);
+    head = tail = -1;
+    count = 0;
+    buffers.clear();
+    free_by_class.assign(64, -1);
+    rows_by_class.assign(64, 0);
+}
 
-    const ImageGray& brush = gBrushes[type];
-    if (brush.width == 0 || brush.height == 0) return;
+void FootprintCache::clear() {
+    setCapacity(capacity());
+    hits = misses = 0;
+}
 
-    // 1) CONFIGURACIÓN DE TAMAÑO / ESCALA (mantener aspecto del brush)
-    //    - 'base' controla el tamaño general
-    const int base = std::max(1, int(size_rel * std::min(C.width, C.height)));
+size_t FootprintCache::home(const FootprintKey& k) const {
+    uint64_t h = uint64_t(uint32_t(k.type)) * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t(uint32_t(k.base)) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2));
+    h ^= (uint64_t(k.rot) * 0xC2B2AE3D27D4EB4Full) + (k.exact ? 0x165667B19E3779F9ull : 0);
+    h ^= uint64_t(k.atlas) * 0xFF51AFD7ED558CCDull;
+    h ^= h >> 29;
+    return size_t(h) & (table.size() - 1);
+}
+
+int FootprintCache::find(const FootprintKey& k) const {
+    const size_t mask = table.size() - 1;
+    for (size_t i = home(k);; i = (i + 1) & mask) {
+        const int e = table[i];
+        if (e < 0) return -1;
+        if (entries[e].key == k) return e;
+    }
+}
+
+void FootprintCache::unlink(int e) {
+    Entry& en = entries[e];
+    if (en.prev >= 0) entries[en.prev].next = en.next; else head = en.next;
+    if (en.next >= 0) entries[en.next].prev = en.prev; else tail = en.prev;
+    en.prev = en.next = -1;
+}
+
+void FootprintCache::pushFront(int e) {
+    entries[e].prev = -1;
+    entries[e].next = head;
+    if (head >= 0) entries[head].prev = e;
+    head = e;
+    if (tail < 0) tail = e;
+}
+
+// Borrado con desplazamiento hacia atrás (sin lápidas)
+void FootprintCache::eraseFromTable(const FootprintKey& k) {
+    const size_t mask = table.size() - 1;
+    size_t i = home(k);
+    while (entries[table[i]].key != k) i = (i + 1) & mask;
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (table[j] < 0) break;
+        const size_t h = home(entries[table[j]].key);
+        const bool movable = (i <= j) ? (h <= i || h > j) : (h <= i && h > j);
+        if (movable) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i] = -1;
+}
+
+const Footprint& FootprintCache::get(const BrushInfo& brush, const FootprintKey& key, float rotation_deg) {
+    int e = find(key);
+    if (e >= 0) {
+        ++hits;
+        if (e != head) { unlink(e); pushFront(e); }
+        return buffers[entries[e].buf].fp;
+    }
+    ++misses;
+
+    if (count < capacity()) {
+        e = count++;
+    } else {
+        // Desalojar el menos usado: su buffer vuelve a su clase
+        e = tail;
+        eraseFromTable(entries[e].key);
+        unlink(e);
+        Buffer& old = buffers[entries[e].buf];
+        old.next = free_by_class[old.cls];
+        free_by_class[old.cls] = entries[e].buf;
+    }
+    entries[e].key = key;
+
+    // Buffer de la clase de la huella nueva (uno libre, o uno nuevo con
+    // la capacidad de la clase); la copia no reserva. Las filas van
+    // aparte: cada buffer se lleva a las máximas vistas en su clase.
+    rasterizeFootprint(brush, key.base, rotation_deg, scratch);
+    const int cls = std::bit_width(scratch.alpha.size());
+    size_t& rows = rows_by_class[cls];
+    rows = std::max(rows, std::bit_ceil(scratch.row_x0.size()));
+    int b = free_by_class[cls];
+    if (b >= 0) {
+        free_by_class[cls] = buffers[b].next;
+    } else {
+        b = (int)buffers.size();
+        Buffer& nb = buffers.emplace_back();
+        nb.cls = cls;
+        const size_t texels = size_t(1) << cls;
+        nb.fp.alpha.reserve(texels);
+        nb.fp.a8.reserve(texels);
+        nb.fp.a8x3.reserve(texels * 3);
+        nb.fp.a16.reserve(texels);
+    }
+    Footprint& fp = buffers[b].fp;
+    fp.row_x0.reserve(rows);
+    fp.row_x1.reserve(rows);
+    fp = scratch;
+    entries[e].buf = b;
+    pushFront(e);
+
+    const size_t mask = table.size() - 1;
+    size_t i = home(key);
+    while (table[i] >= 0) i = (i + 1) & mask;
+    table[i] = e;
+    return fp;
+}
+
+FootprintCache& footprintCache() {
+    static thread_local FootprintCache cache;
+    return cache;
+}
+
+// Rasterizado de la huella (alpha) de un brush a tamaño 'base' y rotación dada
+
+// Cantidad de cuartos de vuelta si la rotación es múltiplo exacto de 90°, o -1
+static int quarterTurns(float rotation_deg) {
+    float r = std::fmod(rotation_deg, 360.0f);
+    if (r < 0.0f) r += 360.0f;
+    if (r == 0.0f || r == 360.0f) return 0;
+    if (r == 90.0f) return 1;
+    if (r == 180.0f) return 2;
+    if (r == 270.0f) return 3;
+    return -1;
+}
+
+void rasterizeFootprint(const BrushInfo& brush, int base, float rotation_deg, Footprint& out) {
     const int bw = brush.width;
     const int bh = brush.height;
 
+    // 1) CONFIGURACIÓN DE TAMAÑO / ESCALA (mantener aspecto del brush)
     // Escala para que el lado MAYOR del brush quede en 'base'
     const float s    = float(base) / float(std::max(bw, bh));  
     const float invs = (s > 0.0f) ? (1.0f / s) : 0.0f;          
 
-    // Tamaño real que ocupará en el canvas respetando el aspecto
-    const int w_pix = std::max(1, int(std::round(bw * s)));
-    const int h_pix = std::max(1, int(std::round(bh * s)));
-    const int halfW = w_pix / 2;
-    const int halfH = h_pix / 2;
-
-    // 2) TRASLACIÓN (MOVER): centro de la pincelada en el canvas
-    const int cx = clampT(int(std::round(x_rel * C.width)),  0, C.width  - 1);
-    const int cy = clampT(int(std::round(y_rel * C.height)), 0, C.height - 1);
+    // 3) ROTACIÓN: precomputar cos/sin del ángulo (en radianes). Los
+    //    múltiplos de 90° usan cos/sin exactos (0/±1) y un kernel sin
+    //    trigonometría; el resto va por el kernel genérico.
+    const int quarter = quarterTurns(rotation_deg);
+    float ct, st;
+    if (quarter >= 0) {
+        const float qc[4] = { 1.0f, 0.0f, -1.0f, 0.0f };
+        ct = qc[quarter];
+        st = qc[(quarter + 3) & 3];
+    } else {
+        const float PI = 3.14159265358979323846f;
+        const float theta = rotation_deg * (PI / 180.0f);
+        ct = std::cos(theta);
+        st = std::sin(theta);
+    }
 
-    // 3) ROTACIÓN: precomputar cos/sin del ángulo (en radianes)
-    const float PI = 3.14159265358979323846f;
-    const float theta = rotation_deg * (PI / 180.0f);
-    const float ct = std::cos(theta);
-    const float st = std::sin(theta);
+    // Nivel mip con resolución cercana a 'base' (la geometría sigue usando
+    // bw/bh del brush original; sólo el muestreo lee la máscara reducida)
+    const BrushLevel& mip = brush.levelFor(base);
+
+    out.row_x0.clear();
+    out.row_x1.clear();
+    out.alpha.clear();
+    out.x0 = out.y0 = out.w = out.h = 0;
+    if (mip.emptyAlpha()) {
+        out.a8.clear();
+        out.a8x3.clear();
+        out.a16.clear();
+        return;
+    }
 
-    // 4) RASTERIZADO: recorrer el rectángulo destino w_pix x h_pix
-    //    Para cada píxel destino, aplicamos la TRANSFORMACIÓN INVERSA:
+    RasterParams p;
+    p.ct = ct;
+    p.st = st;
+    p.invs = invs;
+    p.limX = (bw - 1) * 0.5f;
+    p.limY = (bh - 1) * 0.5f;
+    p.bw1 = float(bw - 1);
+    p.bh1 = float(bh - 1);
+    p.mip = mip.data;
+    p.mw = mip.width;
+    p.mh = mip.height;
+    p.span_x0 = mip.span_x0;
+    p.span_x1 = mip.span_x1;
+
+    // Rectángulo útil del brush (coords del brush centradas): el rectángulo
+    // completo recortado a la caja del alpha no nulo del nivel mip. Un texel
+    // de borde k aporta a muestras con fu en (k-1, k+1).
+    auto mipToBrush = [](double t, int m1, int b1) { return (t / m1 - 0.5) * b1; };
+    double uLo = -p.limX, uHi = p.limX, vLo = -p.limY, vHi = p.limY;
+    if (p.mw > 1) {
+        uLo = std::max(uLo, mipToBrush(mip.bbox_x0 - 1, p.mw - 1, bw - 1));
+        uHi = std::min(uHi, mipToBrush(mip.bbox_x1,     p.mw - 1, bw - 1));
+    }
+    if (p.mh > 1) {
+        vLo = std::max(vLo, mipToBrush(mip.bbox_y0 - 1, p.mh - 1, bh - 1));
+        vHi = std::min(vHi, mipToBrush(mip.bbox_y1,     p.mh - 1, bh - 1));
+    }
+    // ... en píxeles destino
+    uLo *= s; uHi *= s; vLo *= s; vHi *= s;
+
+    // Caja de la huella = extensión de ese rectángulo una vez rotado (cubre
+    // las esquinas rotadas). (u,v) -> (dx,dy) = (u*ct - v*st, u*st + v*ct)
+    const double slack = 1.0 / 64.0;
+    double dxMin = 1e30, dxMax = -1e30, dyMin = 1e30, dyMax = -1e30;
+    for (double u : {uLo, uHi}) {
+        for (double v : {vLo, vHi}) {
+            const double dx = u * ct - v * st;
+            const double dy = u * st + v * ct;
+            dxMin = std::min(dxMin, dx); dxMax = std::max(dxMax, dx);
+            dyMin = std::min(dyMin, dy); dyMax = std::max(dyMax, dy);
+        }
+    }
+    const int bx0 = int(std::floor(dxMin - slack)), bx1 = int(std::ceil(dxMax + slack));
+    const int by0 = int(std::floor(dyMin - slack)), by1 = int(std::ceil(dyMax + slack));
+
+    out.x0 = bx0;
+    out.y0 = by0;
+    out.w  = bx1 - bx0 + 1;
+    out.h  = by1 - by0 + 1;
+    out.alpha.assign(size_t(out.w) * out.h, 0.0f);
+    out.row_x0.assign(out.h, 0);
+    out.row_x1.assign(out.h, 0);
+
+    // 4) RASTERIZADO POR SCANLINES: en cada fila sólo se visita el tramo
+    //    [lo,hi] donde el rectángulo rotado la cubre, es decir donde
+    //      uLo <= dx*ct + dy*st <= uHi   y   vLo <= -dx*st + dy*ct <= vHi
+    //    (con 1/64 px de holgura; el test exacto lo hace el kernel, que
+    //    además salta los texels vacíos según el índice de tramos).
+    //    Para cada píxel del tramo aplicamos la TRANSFORMACIÓN INVERSA:
     //      - des-rotar (R(-θ))
     //      - des-escalar (S(1/s))
     //    para obtener la coordenada (xb,yb) en el espacio del brush.
-    //    Luego muestreamos con bilineal y mezclamos color.
-    for (int dy = -halfH; dy <= halfH; ++dy) {
-        for (int dx = -halfW; dx <= halfW; ++dx) {
-
-            // -------- LÍMITES DEL CANVAS --------
-            const int x_dst = cx + dx;   // TRASLACIÓN aplicada aquí
-            const int y_dst = cy + dy;
-            if (x_dst < 0 || y_dst < 0 || x_dst >= C.width || y_dst >= C.height) continue;
-
-            // -------- ROTACIÓN (inversa) --------
-            // Vector relativo al centro (dx,dy) -> des-rotado
-            const float xr =  dx * ct + dy * st;   // R(-θ) * [dx, dy]
-            const float yr = -dx * st + dy * ct;
-
-            // -------- ESCALA (inversa) --------
-            // Pasar a coordenadas del brush en píxeles, centrado en (0,0)
-            const float xb = xr * invs;
-            const float yb = yr * invs;
-
-            // Si cae fuera del brush original, omitimos
-            if (std::fabs(xb) > (bw - 1) * 0.5f || std::fabs(yb) > (bh - 1) * 0.5f) continue;
-
-            // -------- COORDS NORMALIZADAS [0,1] PARA MUESTREO --------
-            const float tu = (xb / float(bw - 1)) + 0.5f;
-            const float tv = (yb / float(bh - 1)) + 0.5f;
-
-            // 5) MUESTREO BILINEAL DEL BRUSH (canal "alpha"/máscara)
-            const float fu = tu * (bw - 1);
-            const float fv = tv * (bh - 1);
-            int   x0 = (int)std::floor(fu);
-            int   y0 = (int)std::floor(fv);
-            int   x1 = clampT(x0 + 1, 0, bw - 1);
-            int   y1 = clampT(y0 + 1, 0, bh - 1);
-            const float ax = fu - x0;
-            const float ay = fv - y0;
-
-            auto sample = [&](int x, int y) -> float {
-                return brush.data[y * bw + x] / 255.0f;  // [0,1]
-            };
-            const float m00 = sample(x0, y0);
-            const float m10 = sample(x1, y0);
-            const float m01 = sample(x0, y1);
-            const float m11 = sample(x1, y1);
-
-            // 'a' = cobertura/alpha del brush en ese punto destino
-            const float a = (1 - ax) * (1 - ay) * m00
-                          + (    ax) * (1 - ay) * m10
-                          + (1 - ax) * (    ay) * m01
-                          + (    ax) * (    ay) * m11;
+    //    Luego muestreamos con bilineal (kernel SIMD elegido al arrancar).
+    const StrokeKernels& K = strokeKernels();
+    for (int dy = by0; dy <= by1; ++dy) {
+        double lo = bx0, hi = bx1;
+        // Intersecta [lo,hi] con cLo <= a*dx + c <= cHi
+        auto clip = [&](double a, double c, double cLo, double cHi) {
+            if (std::fabs(a) < 1e-9) {
+                if (c < cLo - slack || c > cHi + slack) hi = lo - 1.0;
+                return;
+            }
+            double t0 = (cLo - slack - c) / a;
+            double t1 = (cHi + slack - c) / a;
+            if (t0 > t1) std::swap(t0, t1);
+            lo = std::max(lo, t0);
+            hi = std::min(hi, t1);
+        };
+        clip(ct, dy * (double)st, uLo, uHi);
+        clip(-st, dy * (double)ct, vLo, vHi);
+
+        const int j = dy - by0;
+        const int x0 = std::max(bx0, int(std::ceil(lo)));
+        const int x1 = std::min(bx1, int(std::floor(hi)));
+        if (x0 > x1) continue;
+        out.row_x0[j] = x0 - bx0;
+        out.row_x1[j] = x1 - bx0 + 1;
+        float* dst = &out.alpha[size_t(j) * out.w + out.row_x0[j]];
+        if (quarter >= 0) rasterRowQuarter(p, quarter, dy, x0, x1 - x0 + 1, dst);
+        else              K.rasterRow(p, dy, x0, x1 - x0 + 1, dst);
+    }
+
+    // Versiones enteras del alpha para los modos de mezcla Int8/Int16
+    const size_t n = out.alpha.size();
+    out.a8.resize(n);
+    out.a8x3.resize(n * 3);
+    out.a16.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const float a = clampT(out.alpha[i], 0.0f, 1.0f);
+        out.a8[i]  = (uint8_t)std::lround(a * 255.0f);
+        out.a16[i] = (uint16_t)std::lround(a * 65535.0f);
+        out.a8x3[i * 3 + 0] = out.a8x3[i * 3 + 1] = out.a8x3[i * 3 + 2] = out.a8[i];
+    }
+}
+
+bool parseBlendMode(const std::string& name, BlendMode& out) {
+    if (name == "float") out = BlendMode::Float;
+    else if (name == "int8") out = BlendMode::Int8;
+    else if (name == "int16") out = BlendMode::Int16;
+    else return false;
+    return true;
+}
+
+// Mezclas enteras: out = round((a*fg + (amax-a)*bg) / amax). Como amax es
+// impar no hay empates, y la división por constante es una mult+shift.
+// (blend8 vive en stroke_simd.h junto a sus versiones vectoriales)
+static inline uint8_t blend16(uint32_t a, uint32_t fg, uint32_t bg) {
+    return (uint8_t)((a * fg + (65535u - a) * bg + 32767u) / 65535u);
+}
 
+// Punteros al píxel (x,y) de cada canal; devuelve el paso entre píxeles
+// consecutivos de una fila (3 en interleaved, 1 en planar)
+static inline int channelPtrs(Canvas& C, int x, int y, uint8_t* ch[3]) {
+    if (C.planar()) {
+        for (int c = 0; c < 3; ++c) ch[c] = C.plane(c) + size_t(y) * C.stride + x;
+        return 1;
+    }
+    uint8_t* px = &C.rgb[(size_t(y) * C.width + x) * 3];
+    for (int c = 0; c < 3; ++c) ch[c] = px + c;
+    return 3;
+}
+
+// Mezcla entera (alpha de 16 bits) de la huella trasladada a (cx,cy),
+// ventana [xs,xe) x [ys,ye)
+static void blendInt16(Canvas& C, const Footprint& fp, int cx, int cy,
+                       int xs, int xe, int ys, int ye, const uint8_t fg[3]) {
+    for (int j = ys; j < ye; ++j) {
+        const int i0 = std::max(xs, fp.row_x0[j]);
+        const int i1 = std::min(xe, fp.row_x1[j]);
+        if (i0 >= i1) continue;
+        const uint16_t* arow = fp.a16.data() + size_t(j) * fp.w + i0;
+        uint8_t* ch[3];
+        const int step = channelPtrs(C, cx + fp.x0 + i0, cy + fp.y0 + j, ch);
+        for (int k = 0; k < i1 - i0; ++k) {
+            const uint32_t a = arow[k];
+            if (a == 0) continue;
+            for (int c = 0; c < 3; ++c) ch[c][k * step] = blend16(a, fg[c], ch[c][k * step]);
+        }
+    }
+}
+
+// Huellas angostas (hasta W columnas): la fila se mezcla en línea con un
+// bucle de W iteraciones que el compilador desenrolla por completo
+template <int W>
+static void blendInt8Small(Canvas& C, const Footprint& fp, int cx, int cy,
+                           int xs, int xe, int ys, int ye, const uint8_t fg[3]) {
+    for (int j = ys; j < ye; ++j) {
+        const int i0 = std::max(xs, fp.row_x0[j]);
+        const int n  = std::min(xe, fp.row_x1[j]) - i0;
+        if (n <= 0) continue;
+        const uint8_t* arow = fp.a8.data() + size_t(j) * fp.w + i0;
+        uint8_t* ch[3];
+        const int step = channelPtrs(C, cx + fp.x0 + i0, cy + fp.y0 + j, ch);
+#pragma GCC unroll 16
+        for (int k = 0; k < W; ++k) {
+            if (k >= n) break;
+            const uint32_t a = arow[k];
+            if (a == 0) continue;
+            for (int c = 0; c < 3; ++c) ch[c][k * step] = blend8(a, fg[c], ch[c][k * step]);
+        }
+    }
+}
+
+// Mezcla int8 fila a fila con el kernel SIMD activo: en planar cada canal
+// es un tramo contiguo; en interleaved se mezclan los bytes RGB con el alpha
+// repetido por canal
+static void blendInt8(Canvas& C, const Footprint& fp, int cx, int cy,
+                      int xs, int xe, int ys, int ye, const uint8_t fg[3]) {
+    const StrokeKernels& K = strokeKernels();
+    uint8_t fg48[48];
+    for (int k = 0; k < 48; ++k) fg48[k] = fg[k % 3];
+    for (int j = ys; j < ye; ++j) {
+        const int i0 = std::max(xs, fp.row_x0[j]);
+        const int i1 = std::min(xe, fp.row_x1[j]);
+        if (i0 >= i1) continue;
+        uint8_t* ch[3];
+        channelPtrs(C, cx + fp.x0 + i0, cy + fp.y0 + j, ch);
+        if (C.planar()) {
+            const uint8_t* arow = fp.a8.data() + size_t(j) * fp.w + i0;
+            for (int c = 0; c < 3; ++c) K.blendPlane8(ch[c], arow, fg[c], i1 - i0);
+        } else {
+            const uint8_t* arow = fp.a8x3.data() + (size_t(j) * fp.w + i0) * 3;
+            K.blendRow8(ch[0], arow, fg48, (i1 - i0) * 3);
+        }
+    }
+}
+
+// Mezcla float (referencia)
+static void blendFloat(Canvas& C, const Footprint& fp, int cx, int cy,
+                       int xs, int xe, int ys, int ye, const uint8_t fg[3]) {
+    const float fgF[3] = { float(fg[0]), float(fg[1]), float(fg[2]) };
+    for (int j = ys; j < ye; ++j) {
+        const int i0 = std::max(xs, fp.row_x0[j]);
+        const int i1 = std::min(xe, fp.row_x1[j]);
+        if (i0 >= i1) continue;
+        const float* arow = &fp.alpha[size_t(j) * fp.w + i0];
+        uint8_t* ch[3];
+        const int step = channelPtrs(C, cx + fp.x0 + i0, cy + fp.y0 + j, ch);
+        for (int k = 0; k < i1 - i0; ++k) {
+            const float a = arow[k];
             if (a <= 0.0f) continue;
+            for (int c = 0; c < 3; ++c) {
+                uint8_t& px = ch[c][k * step];
+                const float out = a * fgF[c] + (1.0f - a) * float(px);
+                px = (uint8_t)clampT(int(std::round(out)), 0, 255);
+            }
+        }
+    }
+}
+
+// Clave y posición de la huella de 's' en un canvas de WxH.
+// Devuelve false si el trazo no pinta nada (tipo inválido o brush vacío).
+struct PlacedStroke {
+    FootprintKey key;
+    float rot = 0.0f;
+    int base = 1, cx = 0, cy = 0;
+};
+
+static bool placeStroke(const BrushAtlas& atlas, const Stroke& s, int W, int H,
+                        const RenderOptions& opt, PlacedStroke& out) {
+    // --- Validaciones básicas ---
+    if (s.type < 0 || s.type >= atlas.size()) return false;
+
+    const BrushInfo& brush = atlas[s.type];
+    if (brush.width == 0 || brush.height == 0) return false;
+
+    // 'base' controla el tamaño general (lado mayor del brush en píxeles)
+    out.base = std::max(1, int(s.size_rel * std::min(W, H)));
+
+    // 2) TRASLACIÓN (MOVER): centro de la pincelada en el canvas
+    out.cx = clampT(int(std::round(s.x_rel * W)), 0, W - 1);
+    out.cy = clampT(int(std::round(s.y_rel * H)), 0, H - 1);
+
+    // Clave de la huella: en modo no exacto la rotación se lleva al centro
+    // de su bucket (los buckets dividen 360° en partes iguales)
+    FootprintKey& key = out.key;
+    key = FootprintKey();
+    key.atlas = atlas.id();
+    key.type = s.type;
+    key.base = out.base;
+    out.rot = s.rotation_deg;
+    if (!opt.exact && opt.rot_quantum_deg > 0.0f) {
+        const int nb = std::max(1, int(std::lround(360.0f / opt.rot_quantum_deg)));
+        const float q = 360.0f / nb;
+        float norm = std::fmod(out.rot, 360.0f);
+        if (norm < 0.0f) norm += 360.0f;
+        const int bucket = int(std::lround(norm / q)) % nb;
+        key.rot = uint32_t(bucket);
+        out.rot = bucket * q;
+    } else {
+        key.rot = std::bit_cast<uint32_t>(out.rot);
+        key.exact = true;
+    }
+    return true;
+}
+
+static const Footprint& fetchFootprint(const BrushAtlas& atlas, const PlacedStroke& ps,
+                                       const RenderOptions& opt) {
+    const BrushInfo& brush = atlas[ps.key.type];
+    if (opt.use_cache) return footprintCache().get(brush, ps.key, ps.rot);
+    static thread_local Footprint scratch;
+    rasterizeFootprint(brush, ps.base, ps.rot, scratch);
+    return scratch;
+}
+
+// 6) MEZCLA DE COLOR (SRC OVER) de la huella trasladada a (cx,cy)
+//    - fg = color del stroke (r,g,b)
+//    - bg = color actual del canvas
+//    - out = a*fg + (1-a)*bg
+static void blendFootprint(Canvas& C, const Footprint& fp, int cx, int cy,
+                           const uint8_t fg[3], const RenderOptions& opt,
+                           const Rect* clip = nullptr) {
+    Rect win{0, 0, C.width, C.height};
+    if (clip) win = win.intersected(*clip);
+    const int ys = std::max(0, win.y0 - (cy + fp.y0));
+    const int ye = std::min(fp.h, win.y1 - (cy + fp.y0));
+    const int xs = std::max(0, win.x0 - (cx + fp.x0));
+    const int xe = std::min(fp.w, win.x1 - (cx + fp.x0));
+
+    if (xs >= xe || ys >= ye) return;
+    switch (opt.blend) {
+        case BlendMode::Int8:
+            // Variante por clase de tamaño: las huellas chicas no pagan la
+            // llamada al kernel vectorial por fila
+            if (fp.w <= 8)       blendInt8Small<8>(C, fp, cx, cy, xs, xe, ys, ye, fg);
+            else if (fp.w <= 16) blendInt8Small<16>(C, fp, cx, cy, xs, xe, ys, ye, fg);
+            else                 blendInt8(C, fp, cx, cy, xs, xe, ys, ye, fg);
+            break;
+        case BlendMode::Int16: blendInt16(C, fp, cx, cy, xs, xe, ys, ye, fg); break;
+        case BlendMode::Float: blendFloat(C, fp, cx, cy, xs, xe, ys, ye, fg); break;
+    }
+}
+
+// Caja de los tramos cubiertos de la huella puesta en (ox,oy), recortada
+// al canvas de WxH
+static Rect footprintBox(const Footprint& fp, int ox, int oy, int W, int H) {
+    Rect r{fp.w, fp.h, 0, 0};
+    for (int j = 0; j < fp.h; ++j) {
+        if (fp.row_x0[j] >= fp.row_x1[j]) continue;
+        r.x0 = std::min(r.x0, fp.row_x0[j]);
+        r.x1 = std::max(r.x1, fp.row_x1[j]);
+        r.y0 = std::min(r.y0, j);
+        r.y1 = j + 1;
+    }
+    if (r.empty()) return Rect();
+    r = { r.x0 + ox, r.y0 + oy, r.x1 + ox, r.y1 + oy };
+    return r.intersected(Rect{0, 0, W, H});
+}
+
+void Stroke::draw(const BrushAtlas& atlas, Canvas& C, const RenderOptions& opt) const {
+    PlacedStroke ps;
+    if (!placeStroke(atlas, *this, C.width, C.height, opt, ps)) return;
+    const uint8_t fg[3] = { r, g, b };
+    blendFootprint(C, fetchFootprint(atlas, ps, opt), ps.cx, ps.cy, fg, opt);
+}
+
+void Stroke::draw(const BrushAtlas& atlas, Canvas& C, const Rect& clip, const RenderOptions& opt) const {
+    PlacedStroke ps;
+    if (!placeStroke(atlas, *this, C.width, C.height, opt, ps)) return;
+    const uint8_t fg[3] = { r, g, b };
+    blendFootprint(C, fetchFootprint(atlas, ps, opt), ps.cx, ps.cy, fg, opt, &clip);
+}
+
+Rect Stroke::bounds(const BrushAtlas& atlas, int W, int H, const RenderOptions& opt) const {
+    PlacedStroke ps;
+    if (!placeStroke(atlas, *this, W, H, opt, ps)) return Rect();
+    const Footprint& fp = fetchFootprint(atlas, ps, opt);
+    return footprintBox(fp, ps.cx + fp.x0, ps.cy + fp.y0, W, H);
+}
 
-            // 6) MEZCLA DE COLOR (SRC OVER)
-            //    - fg = color del stroke (r,g,b)
-            //    - bg = color actual del canvas
-            //    - out = a*fg + (1-a)*bg
-            const int idx = (y_dst * C.width + x_dst) * 3;
+// Render con descarte de trazos tapados
 
-            const float bgR = C.rgb[idx + 0];
-            const float bgG = C.rgb[idx + 1];
-            const float bgB = C.rgb[idx + 2];
+// ¿El texel k de la huella es opaco para la mezcla? (el píxel resultante
+// es el color del trazo sin importar el fondo)
+static inline bool opaqueAt(const Footprint& fp, size_t k, BlendMode mode) {
+    switch (mode) {
+        case BlendMode::Int8:  return fp.a8[k] == 255;
+        case BlendMode::Int16: return fp.a16[k] == 65535;
+        default:               return fp.alpha[k] == 1.0f;
+    }
+}
+
+static inline bool paintsAt(const Footprint& fp, size_t k, BlendMode mode) {
+    switch (mode) {
+        case BlendMode::Int8:  return fp.a8[k] != 0;
+        case BlendMode::Int16: return fp.a16[k] != 0;
+        default:               return fp.alpha[k] > 0.0f;
+    }
+}
 
-            const float fgR = float(r);
-            const float fgG = float(g);
-            const float fgB = float(b);
+void renderCulled(const BrushAtlas& atlas, const std::vector<Stroke>& strokes, Canvas& C,
+                  const RenderOptions& opt, std::vector<int>* hidden) {
+    const int N = (int)strokes.size();
+    static thread_local std::vector<uint8_t> covered;
+    static thread_local std::vector<Rect> visible;
+    covered.assign(size_t(C.width) * C.height, 0);
+    visible.assign(N, Rect());
+    if (hidden) hidden->clear();
+
+    // 1) De adelante hacia atrás: caja de lo que cada trazo todavía puede
+    //    cambiar, y luego sus texels opacos tapan lo de abajo
+    for (int j = N - 1; j >= 0; --j) {
+        PlacedStroke ps;
+        if (!placeStroke(atlas, strokes[j], C.width, C.height, opt, ps)) continue;
+        const Footprint& fp = fetchFootprint(atlas, ps, opt);
+        const int ox = ps.cx + fp.x0, oy = ps.cy + fp.y0;
+        const int ys = std::max(0, -oy), ye = std::min(fp.h, C.height - oy);
+
+        Rect vis{C.width, C.height, 0, 0};
+        for (int y = ys; y < ye; ++y) {
+            const int xs = std::max(fp.row_x0[y], -ox), xe = std::min(fp.row_x1[y], C.width - ox);
+            const uint8_t* cov = &covered[size_t(oy + y) * C.width + ox];
+            for (int x = xs; x < xe; ++x) {
+                const size_t k = size_t(y) * fp.w + x;
+                if (cov[x] || !paintsAt(fp, k, opt.blend)) continue;
+                vis.x0 = std::min(vis.x0, ox + x);
+                vis.x1 = std::max(vis.x1, ox + x + 1);
+                vis.y0 = std::min(vis.y0, oy + y);
+                vis.y1 = oy + y + 1;
+            }
+        }
+        if (vis.empty()) {
+            if (hidden) hidden->push_back(j);
+            continue;
+        }
+        visible[j] = vis;
+        for (int y = vis.y0 - oy; y < vis.y1 - oy; ++y) {
+            const int xs = std::max(fp.row_x0[y], vis.x0 - ox), xe = std::min(fp.row_x1[y], vis.x1 - ox);
+            uint8_t* cov = &covered[size_t(oy + y) * C.width + ox];
+            for (int x = xs; x < xe; ++x)
+                if (opaqueAt(fp, size_t(y) * fp.w + x, opt.blend)) cov[x] = 1;
+        }
+    }
+    if (hidden) std::reverse(hidden->begin(), hidden->end());
 
-            const float outR = a * fgR + (1.0f - a) * bgR;
-            const float outG = a * fgG + (1.0f - a) * bgG;
-            const float outB = a * fgB + (1.0f - a) * bgB;
+    // 2) De atrás hacia adelante, sólo lo visible de cada trazo
+    C.clear(255, 255, 255);
+    for (int j = 0; j < N; ++j) {
+        if (!visible[j].empty()) strokes[j].draw(atlas, C, visible[j], opt);
+    }
+}
 
-            C.rgb[idx + 0] = (uint8_t)clampT(int(std::round(outR)), 0, 255);
-            C.rgb[idx + 1] = (uint8_t)clampT(int(std::round(outG)), 0, 255);
-            C.rgb[idx + 2] = (uint8_t)clampT(int(std::round(outB)), 0, 255);
+// Render por lotes
+
+// Pinta K candidatos capa por capa. strokeAt(k, j) devuelve el trazo j del
+// candidato k (o nullptr si no tiene), 'shared' es la cantidad de capas
+// iniciales idénticas en todos. Los canvases deben tener igual tamaño y
+// layout.
+template <typename StrokeAt>
+static void renderLayers(const BrushAtlas& atlas, int K, int layers, int shared,
+                         StrokeAt strokeAt, const std::vector<Canvas*>& canvases,
+                         const RenderOptions& opt) {
+    if (K == 0) return;
+    Canvas& C0 = *canvases[0];
+
+    // 1) Prefijo común: se pinta una vez y se copia al resto
+    C0.clear(255, 255, 255);
+    for (int j = 0; j < shared; ++j) strokeAt(0, j)->draw(atlas, C0, opt);
+    for (int k = 1; k < K; ++k) canvases[k]->rgb = C0.rgb;
+
+    // 2) Resto, capa por capa: los candidatos que piden la misma huella se
+    //    agrupan, así se busca una vez y se mezcla en todos mientras está
+    //    caliente
+    static thread_local std::vector<PlacedStroke> placed;
+    static thread_local std::vector<int> order;
+    if ((int)placed.size() < K) placed.resize(K);
+    order.reserve(K);
+    for (int j = shared; j < layers; ++j) {
+        order.clear();
+        for (int k = 0; k < K; ++k) {
+            const Stroke* s = strokeAt(k, j);
+            if (s && placeStroke(atlas, *s, C0.width, C0.height, opt, placed[k])) order.push_back(k);
+        }
+        for (size_t i = 0; i < order.size(); ++i) {
+            const int k = order[i];
+            if (k < 0) continue; // ya mezclado con su grupo
+            const Footprint& fp = fetchFootprint(atlas, placed[k], opt);
+            for (size_t m = i; m < order.size(); ++m) {
+                const int q = order[m];
+                if (q < 0 || !(placed[q].key == placed[k].key)) continue;
+                const Stroke* s = strokeAt(q, j);
+                const uint8_t fg[3] = { s->r, s->g, s->b };
+                blendFootprint(*canvases[q], fp, placed[q].cx, placed[q].cy, fg, opt);
+                order[m] = -1;
+            }
         }
     }
 }
 
+static bool sameGeometry(const std::vector<Canvas*>& canvases) {
+    for (const Canvas* C : canvases) {
+        if (C->width != canvases[0]->width || C->height != canvases[0]->height
+            || C->layout != canvases[0]->layout) return false;
+    }
+    return true;
+}
+
+void renderBatch(const BrushAtlas& atlas, const std::vector<const std::vector<Stroke>*>& solutions,
+                 const std::vector<Canvas*>& canvases, const RenderOptions& opt) {
+    const int K = (int)std::min(solutions.size(), canvases.size());
+    if (K == 0) return;
+    if (!sameGeometry(canvases)) {
+        for (int k = 0; k < K; ++k) render(atlas, *solutions[k], *canvases[k], opt);
+        return;
+    }
+
+    int layers = 0;
+    for (int k = 0; k < K; ++k) layers = std::max(layers, (int)solutions[k]->size());
+
+    // Largo del prefijo idéntico en todas las soluciones
+    int shared = (int)solutions[0]->size();
+    for (int k = 1; k < K && shared > 0; ++k) {
+        const auto& a = *solutions[0];
+        const auto& b = *solutions[k];
+        int n = std::min(shared, (int)b.size());
+        int j = 0;
+        while (j < n && a[j] == b[j]) ++j;
+        shared = j;
+    }
+
+    renderLayers(atlas, K, layers, shared,
+                 [&](int k, int j) -> const Stroke* {
+                     const auto& sol = *solutions[k];
+                     return j < (int)sol.size() ? &sol[j] : nullptr;
+                 },
+                 canvases, opt);
+}
+
+// Solución en arrays
+
+void StrokeSet::reset(const BrushAtlas& atlas_, int W_, int H_, const RenderOptions& opt_,
+                      const std::vector<Stroke>& strokes) {
+    atlas = &atlas_;
+    W = W_;
+    H = H_;
+    opt = opt_;
+    const size_t n = strokes.size();
+    x_rel.resize(n); y_rel.resize(n); size_rel.resize(n); rotation_deg.resize(n);
+    type.resize(n); r.resize(n); g.resize(n); b.resize(n);
+    key.resize(n); rot.resize(n);
+    base.resize(n); cx.resize(n); cy.resize(n); ox.resize(n); oy.resize(n);
+    w_pix.resize(n); h_pix.resize(n); bbox.resize(n);
+    for (size_t i = 0; i < n; ++i) set((int)i, strokes[i]);
+}
+
+void StrokeSet::place(const Stroke& s, StrokeGeometry& out) const {
+    out = StrokeGeometry();
+    PlacedStroke ps;
+    if (!placeStroke(*atlas, s, W, H, opt, ps)) return;
+    const Footprint& fp = fetchFootprint(*atlas, ps, opt);
+    out.key = ps.key;
+    out.rot = ps.rot;
+    out.base = ps.base;
+    out.cx = ps.cx;
+    out.cy = ps.cy;
+    out.ox = ps.cx + fp.x0;
+    out.oy = ps.cy + fp.y0;
+    out.w_pix = fp.w;
+    out.h_pix = fp.h;
+    out.bbox = footprintBox(fp, out.ox, out.oy, W, H);
+}
+
+void StrokeSet::set(int i, const Stroke& s) {
+    StrokeGeometry geom;
+    place(s, geom);
+    set(i, s, geom);
+}
+
+void StrokeSet::set(int i, const Stroke& s, const StrokeGeometry& geom) {
+    x_rel[i] = s.x_rel;
+    y_rel[i] = s.y_rel;
+    size_rel[i] = s.size_rel;
+    rotation_deg[i] = s.rotation_deg;
+    type[i] = s.type;
+    r[i] = s.r;
+    g[i] = s.g;
+    b[i] = s.b;
+
+    key[i] = geom.key;
+    rot[i] = geom.rot;
+    base[i] = geom.base;
+    cx[i] = geom.cx;
+    cy[i] = geom.cy;
+    ox[i] = geom.ox;
+    oy[i] = geom.oy;
+    w_pix[i] = geom.w_pix;
+    h_pix[i] = geom.h_pix;
+    bbox[i] = geom.bbox;
+}
 
+Stroke StrokeSet::get(int i) const {
+    Stroke s;
+    s.x_rel = x_rel[i];
+    s.y_rel = y_rel[i];
+    s.size_rel = size_rel[i];
+    s.rotation_deg = rotation_deg[i];
+    s.type = type[i];
+    s.r = r[i];
+    s.g = g[i];
+    s.b = b[i];
+    return s;
+}
+
+std::vector<Stroke> StrokeSet::strokes() const {
+    std::vector<Stroke> out(size());
+    for (int i = 0; i < size(); ++i) out[i] = get(i);
+    return out;
+}
+
+// Un trazo sin caja no pinta nada en el canvas: no hace falta su huella
+void StrokeSet::draw(int i, Canvas& C) const {
+    if (bbox[i].empty()) return;
+    const PlacedStroke ps{key[i], rot[i], base[i], cx[i], cy[i]};
+    const uint8_t fg[3] = { r[i], g[i], b[i] };
+    blendFootprint(C, fetchFootprint(*atlas, ps, opt), cx[i], cy[i], fg, opt);
+}
+
+void StrokeSet::draw(int i, Canvas& C, const Rect& clip) const {
+    if (!bbox[i].intersects(clip)) return;
+    const PlacedStroke ps{key[i], rot[i], base[i], cx[i], cy[i]};
+    const uint8_t fg[3] = { r[i], g[i], b[i] };
+    blendFootprint(C, fetchFootprint(*atlas, ps, opt), cx[i], cy[i], fg, opt, &clip);
+}
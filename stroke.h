@@ -1,30 +1,197 @@
 #ifndef STROKE_H
 #define STROKE_H
 
+#include <algorithm>
 #include <vector>
+#include <deque>
 #include <string>
 #include <cstdint>
+#include <new>
+#include "brush_atlas.h"
+
+// Allocator alineado (por defecto a 64 bytes = una línea de caché)
+template <typename T, size_t Align = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Align)); }
+
+    bool operator==(const AlignedAllocator&) const { return true; }
+};
+
+using AlignedBytes = std::vector<uint8_t, AlignedAllocator<uint8_t>>;
 
 // ================= Canvas =================
+// Interleaved: RGBRGB... (formato de los PNG).
+// Planar: planos R, G y B separados, cada fila rellenada a 'stride' bytes
+// (múltiplo de 64) y alineada; lo usan los kernels vectoriales del SA.
+enum class CanvasLayout { Interleaved, Planar };
+
 struct Canvas {
     int width, height;
-    std::vector<uint8_t> rgb; // tamaño = width * height * 3
+    CanvasLayout layout = CanvasLayout::Interleaved;
+    int stride = 0;   // bytes por fila (interleaved: width*3; planar: de cada plano)
+    AlignedBytes rgb; // interleaved: width*height*3; planar: 3 planos de stride*height
 
-    Canvas(int w, int h);
+    Canvas(int w, int h, CanvasLayout layout = CanvasLayout::Interleaved);
     void clear(uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
     void setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
+
+    bool planar() const { return layout == CanvasLayout::Planar; }
+    uint8_t* plane(int c) { return rgb.data() + size_t(c) * stride * height; }
+    const uint8_t* plane(int c) const { return rgb.data() + size_t(c) * stride * height; }
+
+    // Copia con otra disposición de memoria
+    Canvas toLayout(CanvasLayout l) const;
+
+    // Copia reducida f veces (promedio de cada bloque f x f, redondeado;
+    // los bloques del borde promedian sólo los píxeles que existen)
+    Canvas downsample(int f) const;
 };
 
-// Imagen en escala de grises (para brushes)
+// Imagen en escala de grises (carga de brushes; luego se empaquetan en un
+// BrushAtlas)
 struct ImageGray {
     int width = 0, height = 0;
     std::vector<uint8_t> data;
+
+    // Pirámide mip prefiltrada (box 2x2): mips[0] es la mitad de esta imagen,
+    // mips[1] un cuarto, ... hasta 1x1. Sólo se llena en el brush original.
+    std::vector<ImageGray> mips;
+
+    // Índice disperso de alpha > 0: tramo [span_x0[y], span_x1[y]) de cada
+    // fila (vacío si x0 == x1) y caja ajustada [bbox_x0,bbox_x1) x [bbox_y0,bbox_y1)
+    std::vector<int> span_x0, span_x1;
+    int bbox_x0 = 0, bbox_y0 = 0, bbox_x1 = 0, bbox_y1 = 0;
+
 };
 
 bool loadImageGray(const std::string& filename, ImageGray& out);
-bool savePNG(const Canvas& C, const std::string& filename);
+void buildMips(ImageGray& img);
+void buildSpanIndex(ImageGray& img);
+bool savePNG(const Canvas& C, const std::string& filename); // convierte si es planar
+bool parseCanvasLayout(const std::string& name, CanvasLayout& out);
+
+// ================= Render =================
+// Mezcla src-over: en float (referencia) o en enteros con alpha de 8/16 bits
+// y redondeo exacto, sin operaciones en coma flotante.
+enum class BlendMode { Float, Int8, Int16 };
+
+// Opciones de rasterizado. Por defecto: render exacto (referencia); el SA
+// usa rotaciones cuantizadas para reutilizar huellas de la caché.
+struct RenderOptions {
+    bool  exact = true;            // rotación sin cuantizar
+    float rot_quantum_deg = 1.0f;  // tamaño del bucket de rotación (si !exact)
+    bool  use_cache = true;        // false: rasteriza cada trazo desde cero
+    BlendMode blend = BlendMode::Float;
+};
+
+bool parseBlendMode(const std::string& name, BlendMode& out);
+
+// Huella de un trazo: alpha ya rasterizado en la grilla del canvas,
+// con la esquina (x0,y0) relativa al centro del trazo. La caja incluye la
+// extensión rotada del brush; fuera de [row_x0[j], row_x1[j]) alpha = 0.
+struct Footprint {
+    int x0 = 0, y0 = 0;
+    int w = 0, h = 0;
+    std::vector<int> row_x0, row_x1; // span cubierto de cada fila
+    std::vector<float> alpha;   // w*h, en [0,1]
+    std::vector<uint8_t> a8;    // alpha cuantizado a [0,255]
+    std::vector<uint8_t> a8x3;  // a8 repetido por canal (para mezclar bytes RGB)
+    std::vector<uint16_t> a16;  // alpha cuantizado a [0,65535]
+};
+
+// Clave de la caché: atlas, tipo de brush, tamaño entero en píxeles y
+// rotación (índice de bucket, o los bits del float en modo exacto)
+struct FootprintKey {
+    uint32_t atlas = 0;
+    int      type = 0;
+    int      base = 0;
+    uint32_t rot = 0;
+    bool     exact = false;
+
+    bool operator==(const FootprintKey&) const = default;
+};
+
+// Caché LRU acotada de huellas. Tabla hash abierta + lista doblemente
+// enlazada sobre slots fijos. Las huellas viven en buffers agrupados por
+// clase de tamaño (texels redondeados a potencia de 2): al desalojar, el
+// buffer vuelve a su clase y la huella nueva toma uno de la suya. La
+// memoria sigue a las huellas que realmente hay y, una vez que cada clase
+// tiene sus buffers, no se reserva más.
+class FootprintCache {
+public:
+    explicit FootprintCache(int capacity = 1024);
+
+    const Footprint& get(const BrushInfo& brush, const FootprintKey& key, float rotation_deg);
+    void setCapacity(int capacity);
+    void clear();
+
+    int capacity() const { return (int)entries.size(); }
+    int size() const { return count; }
+
+    long long hits = 0;
+    long long misses = 0;
+
+private:
+    struct Entry {
+        FootprintKey key;
+        int buf = -1;
+        int prev = -1, next = -1;
+    };
+    struct Buffer {
+        Footprint fp;
+        int cls = 0;    // capacidad: 2^cls texels
+        int next = -1;  // siguiente libre de la misma clase
+    };
+    std::vector<Entry> entries;
+    std::vector<int> table; // slot por posición hash, -1 = vacío
+    int head = -1, tail = -1, count = 0;
+    std::deque<Buffer> buffers;       // deque: no se mueven al crecer
+    std::vector<int> free_by_class;   // primer buffer libre de cada clase
+    std::vector<size_t> rows_by_class; // filas máximas vistas en cada clase
+    Footprint scratch;                // se rasteriza acá y se copia al buffer
+
+    size_t home(const FootprintKey& k) const;
+    int  find(const FootprintKey& k) const;
+    void unlink(int e);
+    void pushFront(int e);
+    void eraseFromTable(const FootprintKey& k);
+};
+
+// Caché usada por Stroke::draw (una por hilo)
+FootprintCache& footprintCache();
+
+void rasterizeFootprint(const BrushInfo& brush, int base, float rotation_deg, Footprint& out);
 
 // ================= Stroke =================
+// Rectángulo de píxeles [x0,x1) x [y0,y1)
+struct Rect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+    int area() const { return empty() ? 0 : (x1 - x0) * (y1 - y0); }
+    bool operator==(const Rect&) const = default;
+    bool intersects(const Rect& o) const {
+        return !empty() && !o.empty() && x0 < o.x1 && o.x0 < x1 && y0 < o.y1 && o.y0 < y1;
+    }
+    Rect united(const Rect& o) const {
+        if (empty()) return o;
+        if (o.empty()) return *this;
+        return { std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1) };
+    }
+    Rect intersected(const Rect& o) const {
+        return { std::max(x0, o.x0), std::max(y0, o.y0), std::min(x1, o.x1), std::min(y1, o.y1) };
+    }
+};
+
 struct Stroke {
     float x_rel = 0.5f;
     float y_rel = 0.5f;
@@ -37,15 +204,93 @@ struct Stroke {
     Stroke(float xr, float yr, float sr, float rot, int t,
            uint8_t rr, uint8_t gg, uint8_t bb);
 
-    void draw(Canvas& C) const;
+    void draw(const BrushAtlas& atlas, Canvas& C, const RenderOptions& opt = RenderOptions()) const;
+    // Igual que draw pero sólo toca los píxeles dentro de 'clip'
+    void draw(const BrushAtlas& atlas, Canvas& C, const Rect& clip,
+              const RenderOptions& opt = RenderOptions()) const;
+
+    // Caja de los píxeles que puede tocar en un canvas de WxH (vacía si no pinta)
+    Rect bounds(const BrushAtlas& atlas, int W, int H, const RenderOptions& opt = RenderOptions()) const;
+
+    bool operator==(const Stroke&) const = default;
 };
 
 // Pinta el lienzo con todos los strokes (en el orden recibido)
-void render(const std::vector<Stroke>& strokes, Canvas& C);
+void render(const BrushAtlas& atlas, const std::vector<Stroke>& strokes, Canvas& C,
+            const RenderOptions& opt = RenderOptions());
 
-bool loadImageRGB_asCanvas(const std::string& filename, Canvas& out);
+// Igual que render, pero primero recorre los trazos de adelante hacia
+// atrás marcando los píxeles que alguno cubre con alpha máximo (ahí el
+// resultado ya no depende de lo de abajo): cada trazo sólo se pinta dentro
+// de la caja de lo que todavía puede cambiar, y los tapados del todo no se
+// pintan. Resultado idéntico a render(). 'hidden' recibe los índices de
+// los trazos tapados, en orden.
+void renderCulled(const BrushAtlas& atlas, const std::vector<Stroke>& strokes, Canvas& C,
+                  const RenderOptions& opt = RenderOptions(), std::vector<int>* hidden = nullptr);
+
+// Pinta K soluciones en K canvases (mismo tamaño y layout) de una pasada:
+// el prefijo común se pinta una sola vez y se copia, y el resto va capa por
+// capa, mezclando cada huella en todos los candidatos que la usan.
+// Resultado idéntico a llamar render() para cada una.
+void renderBatch(const BrushAtlas& atlas, const std::vector<const std::vector<Stroke>*>& solutions,
+                 const std::vector<Canvas*>& canvases, const RenderOptions& opt = RenderOptions());
+
+// ================= Solución en arrays =================
+// Geometría de un trazo en un canvas de WxH con opciones fijas: lo que
+// draw() deriva de los parámetros cada vez.
+struct StrokeGeometry {
+    FootprintKey key;          // huella en la caché
+    float rot = 0.0f;          // rotación efectiva (al centro de su bucket)
+    int base = 1;              // lado mayor del brush en píxeles
+    int cx = 0, cy = 0;        // centro en píxeles
+    int ox = 0, oy = 0;        // esquina de la huella en el canvas
+    int w_pix = 0, h_pix = 0;  // tamaño de la huella
+    Rect bbox;                 // caja de lo que pinta (vacía = no pinta)
+};
+
+// Solución como estructura de arrays: cada parámetro de los trazos en su
+// propio array contiguo y, al lado, su geometría ya derivada para un canvas
+// de WxH. set() recalcula sólo el trazo que cambió, así que pintar o
+// consultar la caja no vuelve a ubicar el trazo ni a recorrer su huella.
+// El seno y coseno de la rotación no se guardan: sólo se usan al
+// rasterizar la huella, que ya queda en la caché por su clave.
+class StrokeSet {
+public:
+    void reset(const BrushAtlas& atlas, int W, int H, const RenderOptions& opt,
+               const std::vector<Stroke>& strokes);
+
+    // Geometría de 's' en este canvas (no lo modifica)
+    void place(const Stroke& s, StrokeGeometry& g) const;
+    void set(int i, const Stroke& s);
+    void set(int i, const Stroke& s, const StrokeGeometry& g); // 'g' ya calculada con place()
+
+    int size() const { return (int)x_rel.size(); }
+    Stroke get(int i) const;
+    std::vector<Stroke> strokes() const;
+    const Rect& bounds(int i) const { return bbox[i]; }
+
+    // Igual que Stroke::draw con la geometría guardada
+    void draw(int i, Canvas& C) const;
+    void draw(int i, Canvas& C, const Rect& clip) const;
+
+    // Parámetros
+    std::vector<float> x_rel, y_rel, size_rel, rotation_deg;
+    std::vector<int> type;
+    std::vector<uint8_t> r, g, b;
+
+    // Geometría derivada
+    std::vector<FootprintKey> key;
+    std::vector<float> rot;
+    std::vector<int> base, cx, cy, ox, oy, w_pix, h_pix;
+    std::vector<Rect> bbox;
+
+private:
+    const BrushAtlas* atlas = nullptr;
+    int W = 0, H = 0;
+    RenderOptions opt;
+};
 
-// Brushes globales (máscaras en gris). Se cargan en testCall.cpp
-extern std::vector<ImageGray> gBrushes;
+bool loadImageRGB_asCanvas(const std::string& filename, Canvas& out,
+                           CanvasLayout layout = CanvasLayout::Interleaved);
 
 #endif
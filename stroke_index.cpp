@@ -0,0 +1,81 @@
+#include "stroke_index.h"
+#include <algorithm>
+
+void StrokeIndex::build(int width, int height, int bin_size, const std::vector<Rect>& rs) {
+    bin = std::max(1, bin_size);
+    bins_x = std::max(1, (width + bin - 1) / bin);
+    bins_y = std::max(1, (height + bin - 1) / bin);
+    bins.assign(size_t(bins_x) * bins_y, {});
+    rects = rs;
+    // Un bin nunca tiene más de size() ids: update no reserva memoria
+    for (std::vector<int>& v : bins) v.reserve(rects.size());
+
+    // Se insertan en orden: cada bin queda ordenado sin más trabajo
+    for (int id = 0; id < (int)rects.size(); ++id) {
+        int bx0, by0, bx1, by1;
+        if (!binRange(rects[id], bx0, by0, bx1, by1)) continue;
+        for (int by = by0; by <= by1; ++by)
+            for (int bx = bx0; bx <= bx1; ++bx) bins[size_t(by) * bins_x + bx].push_back(id);
+    }
+}
+
+bool StrokeIndex::binRange(const Rect& r, int& bx0, int& by0, int& bx1, int& by1) const {
+    if (r.empty()) return false;
+    bx0 = std::clamp(r.x0 / bin, 0, bins_x - 1);
+    by0 = std::clamp(r.y0 / bin, 0, bins_y - 1);
+    bx1 = std::clamp((r.x1 - 1) / bin, 0, bins_x - 1);
+    by1 = std::clamp((r.y1 - 1) / bin, 0, bins_y - 1);
+    return true;
+}
+
+void StrokeIndex::update(int id, const Rect& r) {
+    int ox0 = 0, oy0 = 0, ox1 = -1, oy1 = -1;
+    int nx0 = 0, ny0 = 0, nx1 = -1, ny1 = -1;
+    binRange(rects[id], ox0, oy0, ox1, oy1);
+    binRange(r, nx0, ny0, nx1, ny1);
+    rects[id] = r;
+    if (ox0 == nx0 && oy0 == ny0 && ox1 == nx1 && oy1 == ny1) return; // mismos bins
+
+    auto inside = [](int bx, int by, int x0, int y0, int x1, int y1) {
+        return bx >= x0 && bx <= x1 && by >= y0 && by <= y1;
+    };
+    // Sacar de los bins que ya no toca
+    for (int by = oy0; by <= oy1; ++by) {
+        for (int bx = ox0; bx <= ox1; ++bx) {
+            if (inside(bx, by, nx0, ny0, nx1, ny1)) continue;
+            auto& v = bins[size_t(by) * bins_x + bx];
+            auto it = std::lower_bound(v.begin(), v.end(), id);
+            if (it != v.end() && *it == id) v.erase(it);
+        }
+    }
+    // Agregar (en su lugar) a los bins nuevos
+    for (int by = ny0; by <= ny1; ++by) {
+        for (int bx = nx0; bx <= nx1; ++bx) {
+            if (inside(bx, by, ox0, oy0, ox1, oy1)) continue;
+            auto& v = bins[size_t(by) * bins_x + bx];
+            v.insert(std::lower_bound(v.begin(), v.end(), id), id);
+        }
+    }
+}
+
+void StrokeIndex::query(const Rect& r, std::vector<int>& out) const {
+    out.clear();
+    out.reserve(rects.size());
+    int bx0, by0, bx1, by1;
+    if (!binRange(r, bx0, by0, bx1, by1)) return;
+    for (int by = by0; by <= by1; ++by) {
+        for (int bx = bx0; bx <= bx1; ++bx) {
+            for (int id : bins[size_t(by) * bins_x + bx]) {
+                if (!rects[id].intersects(r)) continue;
+                // Un trazo puede estar en varios bins: sólo lo agrega el
+                // primero del rango que comparten (sin repetidos, out no
+                // pasa de size())
+                int ix0, iy0, ix1, iy1;
+                binRange(rects[id], ix0, iy0, ix1, iy1);
+                if (std::max(ix0, bx0) == bx && std::max(iy0, by0) == by) out.push_back(id);
+            }
+        }
+    }
+    // Recorridos por bin: volver al orden de pintado
+    if (bx0 != bx1 || by0 != by1) std::sort(out.begin(), out.end());
+}
@@ -0,0 +1,34 @@
+#ifndef STROKE_INDEX_H
+#define STROKE_INDEX_H
+
+#include "stroke.h"
+#include <vector>
+
+// ================= Índice espacial de trazos =================
+// Grilla uniforme de bins sobre el canvas: cada bin guarda, ordenados, los
+// ids de los trazos cuya caja lo toca. Mover un trazo sólo toca los bins
+// de su caja vieja y de la nueva.
+class StrokeIndex {
+public:
+    // Índice de los trazos con cajas 'rects' (id = posición = orden de pintado)
+    void build(int width, int height, int bin_size, const std::vector<Rect>& rects);
+
+    // El trazo 'id' ahora ocupa 'r'
+    void update(int id, const Rect& r);
+
+    // Ids de los trazos cuya caja toca 'r', en orden de pintado
+    void query(const Rect& r, std::vector<int>& out) const;
+
+    const Rect& rect(int id) const { return rects[id]; }
+    int size() const { return (int)rects.size(); }
+
+private:
+    int bin = 16, bins_x = 0, bins_y = 0;
+    std::vector<std::vector<int>> bins;
+    std::vector<Rect> rects;
+
+    // Rango de bins [bx0,bx1] x [by0,by1] que toca 'r' (false si está vacía)
+    bool binRange(const Rect& r, int& bx0, int& by0, int& bx1, int& by1) const;
+};
+
+#endif
@@ -0,0 +1,598 @@
+#include "stroke_simd.h"
+#include "stroke.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STROKE_SIMD_X86 1
+#endif
+
+template <typename T>
+static inline T clampT(T v, T lo, T hi) {
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+// ================= Escalar (referencia) =================
+
+static void rasterRowScalar(const RasterParams& p, int dy, int dx0, int n, float* out) {
+    for (int i = 0; i < n; ++i) {
+        const int dx = dx0 + i;
+        out[i] = 0.0f;
+
+        // -------- ROTACIÓN (inversa) --------
+        // Vector relativo al centro (dx,dy) -> des-rotado
+        const float xr =  dx * p.ct + dy * p.st;   // R(-θ) * [dx, dy]
+        const float yr = -dx * p.st + dy * p.ct;
+
+        // -------- ESCALA (inversa) --------
+        // Pasar a coordenadas del brush en píxeles, centrado en (0,0)
+        const float xb = xr * p.invs;
+        const float yb = yr * p.invs;
+
+        // Si cae fuera del brush original, omitimos
+        if (std::fabs(xb) > p.limX || std::fabs(yb) > p.limY) continue;
+
+        // -------- COORDS NORMALIZADAS [0,1] PARA MUESTREO --------
+        const float tu = (xb / p.bw1) + 0.5f;
+        const float tv = (yb / p.bh1) + 0.5f;
+
+        // MUESTREO BILINEAL DEL NIVEL MIP (canal "alpha"/máscara)
+        const float fu = tu * (p.mw - 1);
+        const float fv = tv * (p.mh - 1);
+        int   x0 = clampT((int)std::floor(fu), 0, p.mw - 1);
+        int   y0 = clampT((int)std::floor(fv), 0, p.mh - 1);
+        int   x1 = clampT(x0 + 1, 0, p.mw - 1);
+        int   y1 = clampT(y0 + 1, 0, p.mh - 1);
+        // Los 4 texels caen fuera de los tramos no nulos: alpha = 0
+        if (!texelsCovered(p, x0, x1, y0, y1)) continue;
+
+        const float ax = fu - x0;
+        const float ay = fv - y0;
+
+        auto sample = [&](int x, int y) -> float {
+            return p.mip[y * p.mw + x] / 255.0f;  // [0,1]
+        };
+        const float m00 = sample(x0, y0);
+        const float m10 = sample(x1, y0);
+        const float m01 = sample(x0, y1);
+        const float m11 = sample(x1, y1);
+
+        // 'a' = cobertura/alpha del brush en ese punto destino
+        out[i] = (1 - ax) * (1 - ay) * m00
+               + (    ax) * (1 - ay) * m10
+               + (1 - ax) * (    ay) * m01
+               + (    ax) * (    ay) * m11;
+    }
+}
+
+// ================= Rotaciones múltiplo de 90° =================
+
+// Índices y peso bilineal sobre un eje del nivel mip para la coordenada
+// centrada 'coord' (en píxeles destino), como en rasterRowScalar
+struct AxisSample {
+    bool inside;
+    int i0, i1;
+    float w;
+};
+
+static inline AxisSample axisSample(float coord, float invs, float lim, float b1, int m) {
+    AxisSample a;
+    const float b = coord * invs;
+    a.inside = !(std::fabs(b) > lim);
+    const float f = ((b / b1) + 0.5f) * (m - 1);
+    a.i0 = clampT((int)std::floor(f), 0, m - 1);
+    a.i1 = clampT(a.i0 + 1, 0, m - 1);
+    a.w = f - a.i0;
+    return a;
+}
+
+template <int Q>
+static void rasterRowQuarterT(const RasterParams& p, int dy, int dx0, int n, float* out) {
+    // Q par: la fila fija yr (= ±dy) y xr = ±dx; Q impar: la fila fija xr
+    // (= ±dy) e yr = ∓dx. El eje fijo se muestrea una sola vez.
+    constexpr bool rowIsY = (Q % 2 == 0);
+    const float rowCoord = (Q == 0 || Q == 1) ? float(dy) : float(-dy);
+    const AxisSample fixed = rowIsY ? axisSample(rowCoord, p.invs, p.limY, p.bh1, p.mh)
+                                    : axisSample(rowCoord, p.invs, p.limX, p.bw1, p.mw);
+    if (!fixed.inside) {
+        std::fill_n(out, n, 0.0f);
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        const int dx = dx0 + i;
+        const float varCoord = (Q == 0 || Q == 3) ? float(dx) : float(-dx);
+        const AxisSample var = rowIsY ? axisSample(varCoord, p.invs, p.limX, p.bw1, p.mw)
+                                      : axisSample(varCoord, p.invs, p.limY, p.bh1, p.mh);
+        out[i] = 0.0f;
+        if (!var.inside) continue;
+
+        const AxisSample& X = rowIsY ? var : fixed;
+        const AxisSample& Y = rowIsY ? fixed : var;
+        if (!texelsCovered(p, X.i0, X.i1, Y.i0, Y.i1)) continue;
+
+        const float ax = X.w, ay = Y.w;
+        auto sample = [&](int x, int y) -> float {
+            return p.mip[y * p.mw + x] / 255.0f;  // [0,1]
+        };
+        out[i] = (1 - ax) * (1 - ay) * sample(X.i0, Y.i0)
+               + (    ax) * (1 - ay) * sample(X.i1, Y.i0)
+               + (1 - ax) * (    ay) * sample(X.i0, Y.i1)
+               + (    ax) * (    ay) * sample(X.i1, Y.i1);
+    }
+}
+
+void rasterRowQuarter(const RasterParams& p, int quarter, int dy, int dx0, int n, float* out) {
+    switch (quarter & 3) {
+        case 0: rasterRowQuarterT<0>(p, dy, dx0, n, out); break;
+        case 1: rasterRowQuarterT<1>(p, dy, dx0, n, out); break;
+        case 2: rasterRowQuarterT<2>(p, dy, dx0, n, out); break;
+        case 3: rasterRowQuarterT<3>(p, dy, dx0, n, out); break;
+    }
+}
+
+static void blendRow8Scalar(uint8_t* dst, const uint8_t* a, const uint8_t* fg48, int nbytes) {
+    for (int k = 0; k < nbytes; k += 3) {
+        if (a[k] == 0) continue;
+        dst[k + 0] = blend8(a[k], fg48[0], dst[k + 0]);
+        dst[k + 1] = blend8(a[k], fg48[1], dst[k + 1]);
+        dst[k + 2] = blend8(a[k], fg48[2], dst[k + 2]);
+    }
+}
+
+static void blendPlane8Scalar(uint8_t* dst, const uint8_t* a, uint8_t fg, int n) {
+    for (int k = 0; k < n; ++k) {
+        if (a[k] == 0) continue;
+        dst[k] = blend8(a[k], fg, dst[k]);
+    }
+}
+
+static uint64_t sse8Scalar(const uint8_t* a, const uint8_t* b, int n) {
+    uint64_t sum = 0;
+    for (int k = 0; k < n; ++k) {
+        const int d = int(a[k]) - int(b[k]);
+        sum += uint32_t(d * d);
+    }
+    return sum;
+}
+
+#ifdef STROKE_SIMD_X86
+
+// Lectura de los 4 texels de cada lane. Los lanes fuera del brush o cuyos
+// texels caen fuera de los tramos no nulos no leen la máscara (quedan en 0).
+// xy = {x0, x1, y0, y1} por lane.
+template <int L>
+static inline void fetchTexels(const RasterParams& p, int insideMask,
+                               const int32_t (*idx)[L], const int32_t (*xy)[L], int32_t (*m)[L]) {
+    for (int l = 0; l < L; ++l) {
+        if (((insideMask >> l) & 1) && texelsCovered(p, xy[0][l], xy[1][l], xy[2][l], xy[3][l])) {
+            for (int c = 0; c < 4; ++c) m[c][l] = p.mip[idx[c][l]];
+        } else {
+            for (int c = 0; c < 4; ++c) m[c][l] = 0;
+        }
+    }
+}
+
+// ================= SSE4.1 (4 píxeles / 48 bytes por paso) =================
+// Mismas operaciones y en el mismo orden que el escalar (sin FMA), para que
+// el resultado sea idéntico bit a bit.
+
+__attribute__((target("sse4.1")))
+static void rasterRowSSE41(const RasterParams& p, int dy, int dx0, int n, float* out) {
+    const __m128 ct = _mm_set1_ps(p.ct), st = _mm_set1_ps(p.st);
+    const __m128 invs = _mm_set1_ps(p.invs);
+    const __m128 limX = _mm_set1_ps(p.limX), limY = _mm_set1_ps(p.limY);
+    const __m128 bw1 = _mm_set1_ps(p.bw1), bh1 = _mm_set1_ps(p.bh1);
+    const __m128 mw1 = _mm_set1_ps(float(p.mw - 1)), mh1 = _mm_set1_ps(float(p.mh - 1));
+    const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), k255 = _mm_set1_ps(255.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mwMax = _mm_set1_epi32(p.mw - 1), mhMax = _mm_set1_epi32(p.mh - 1);
+    const __m128i mw = _mm_set1_epi32(p.mw), ione = _mm_set1_epi32(1);
+    const __m128 fdy = _mm_set1_ps(float(dy));
+    const __m128 dySt = _mm_mul_ps(fdy, st), dyCt = _mm_mul_ps(fdy, ct);
+    const __m128i iota = _mm_setr_epi32(0, 1, 2, 3);
+
+    alignas(16) int32_t idx[4][4];
+    alignas(16) int32_t xy[4][4];
+    alignas(16) int32_t m[4][4];
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 fdx = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(dx0 + i), iota));
+        const __m128 nfdx = _mm_sub_ps(_mm_setzero_ps(), fdx);
+        const __m128 xb = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(fdx, ct), dySt), invs);
+        const __m128 yb = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(nfdx, st), dyCt), invs);
+        const __m128 inside = _mm_and_ps(_mm_cmple_ps(_mm_and_ps(xb, absMask), limX),
+                                         _mm_cmple_ps(_mm_and_ps(yb, absMask), limY));
+        if (_mm_movemask_ps(inside) == 0) {
+            _mm_storeu_ps(out + i, _mm_setzero_ps());
+            continue;
+        }
+        const __m128 fu = _mm_mul_ps(_mm_add_ps(_mm_div_ps(xb, bw1), half), mw1);
+        const __m128 fv = _mm_mul_ps(_mm_add_ps(_mm_div_ps(yb, bh1), half), mh1);
+        const __m128i x0 = _mm_min_epi32(_mm_max_epi32(_mm_cvttps_epi32(_mm_floor_ps(fu)), zero), mwMax);
+        const __m128i y0 = _mm_min_epi32(_mm_max_epi32(_mm_cvttps_epi32(_mm_floor_ps(fv)), zero), mhMax);
+        const __m128i x1 = _mm_min_epi32(_mm_add_epi32(x0, ione), mwMax);
+        const __m128i y1 = _mm_min_epi32(_mm_add_epi32(y0, ione), mhMax);
+        const __m128 ax = _mm_sub_ps(fu, _mm_cvtepi32_ps(x0));
+        const __m128 ay = _mm_sub_ps(fv, _mm_cvtepi32_ps(y0));
+
+        const __m128i r0 = _mm_mullo_epi32(y0, mw), r1 = _mm_mullo_epi32(y1, mw);
+        _mm_store_si128((__m128i*)idx[0], _mm_add_epi32(r0, x0));
+        _mm_store_si128((__m128i*)idx[1], _mm_add_epi32(r0, x1));
+        _mm_store_si128((__m128i*)idx[2], _mm_add_epi32(r1, x0));
+        _mm_store_si128((__m128i*)idx[3], _mm_add_epi32(r1, x1));
+        _mm_store_si128((__m128i*)xy[0], x0);
+        _mm_store_si128((__m128i*)xy[1], x1);
+        _mm_store_si128((__m128i*)xy[2], y0);
+        _mm_store_si128((__m128i*)xy[3], y1);
+        fetchTexels<4>(p, _mm_movemask_ps(inside), idx, xy, m);
+
+        const __m128 m00 = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)m[0])), k255);
+        const __m128 m10 = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)m[1])), k255);
+        const __m128 m01 = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)m[2])), k255);
+        const __m128 m11 = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)m[3])), k255);
+
+        const __m128 nax = _mm_sub_ps(one, ax), nay = _mm_sub_ps(one, ay);
+        __m128 a = _mm_mul_ps(_mm_mul_ps(nax, nay), m00);
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_mul_ps(ax, nay), m10));
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_mul_ps(nax, ay), m01));
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_mul_ps(ax, ay), m11));
+        _mm_storeu_ps(out + i, _mm_and_ps(a, inside));
+    }
+    if (i < n) rasterRowScalar(p, dy, dx0 + i, n - i, out + i);
+}
+
+// 8 bytes en lanes de 16 bits: (a*fg + (255-a)*bg + 128 + (v>>8)) >> 8
+__attribute__((target("sse4.1")))
+static inline __m128i blend8x8SSE41(__m128i bg, __m128i al, __m128i fg) {
+    const __m128i c255 = _mm_set1_epi16(255), c128 = _mm_set1_epi16(128);
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(al, fg), _mm_mullo_epi16(_mm_sub_epi16(c255, al), bg));
+    v = _mm_add_epi16(v, c128);
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i blend8x16SSE41(__m128i bg, __m128i al, __m128i fgLo, __m128i fgHi) {
+    const __m128i lo = blend8x8SSE41(_mm_cvtepu8_epi16(bg), _mm_cvtepu8_epi16(al), fgLo);
+    const __m128i hi = blend8x8SSE41(_mm_cvtepu8_epi16(_mm_srli_si128(bg, 8)),
+                                     _mm_cvtepu8_epi16(_mm_srli_si128(al, 8)), fgHi);
+    return _mm_packus_epi16(lo, hi);
+}
+
+__attribute__((target("sse4.1")))
+static void blendRow8SSE41(uint8_t* dst, const uint8_t* a, const uint8_t* fg48, int nbytes) {
+    __m128i fgLo[3], fgHi[3];
+    for (int c = 0; c < 3; ++c) {
+        const __m128i f = _mm_loadu_si128((const __m128i*)(fg48 + 16 * c));
+        fgLo[c] = _mm_cvtepu8_epi16(f);
+        fgHi[c] = _mm_cvtepu8_epi16(_mm_srli_si128(f, 8));
+    }
+    int k = 0;
+    for (; k + 48 <= nbytes; k += 48) {
+        for (int c = 0; c < 3; ++c) {
+            uint8_t* d = dst + k + 16 * c;
+            const __m128i bg = _mm_loadu_si128((const __m128i*)d);
+            const __m128i al = _mm_loadu_si128((const __m128i*)(a + k + 16 * c));
+            _mm_storeu_si128((__m128i*)d, blend8x16SSE41(bg, al, fgLo[c], fgHi[c]));
+        }
+    }
+    for (int c = 0; k + 16 <= nbytes; k += 16, ++c) {
+        const __m128i bg = _mm_loadu_si128((const __m128i*)(dst + k));
+        const __m128i al = _mm_loadu_si128((const __m128i*)(a + k));
+        _mm_storeu_si128((__m128i*)(dst + k), blend8x16SSE41(bg, al, fgLo[c], fgHi[c]));
+    }
+    for (; k < nbytes; ++k) dst[k] = blend8(a[k], fg48[k % 48], dst[k]);
+}
+
+__attribute__((target("sse4.1")))
+static void blendPlane8SSE41(uint8_t* dst, const uint8_t* a, uint8_t fg, int n) {
+    const __m128i f = _mm_set1_epi16(fg);
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        const __m128i bg = _mm_loadu_si128((const __m128i*)(dst + k));
+        const __m128i al = _mm_loadu_si128((const __m128i*)(a + k));
+        _mm_storeu_si128((__m128i*)(dst + k), blend8x16SSE41(bg, al, f, f));
+    }
+    blendPlane8Scalar(dst + k, a + k, fg, n - k);
+}
+
+// Error cuadrático con SSE2: diferencias en 16 bits y madd (pares de
+// cuadrados sumados en 32 bits). Cada lane de 32 bits suma a lo sumo
+// 2*255^2 por paso: se vuelca a 64 bits cada 4096 pasos.
+__attribute__((target("sse2")))
+static inline __m128i sqDiff16x8(__m128i a, __m128i b) {
+    const __m128i d = _mm_sub_epi16(a, b);
+    return _mm_madd_epi16(d, d);
+}
+
+__attribute__((target("sse2")))
+static inline uint64_t hsum64(__m128i v) {
+    alignas(16) uint64_t t[2];
+    _mm_store_si128((__m128i*)t, v);
+    return t[0] + t[1];
+}
+
+__attribute__((target("sse2")))
+static inline __m128i widen32to64(__m128i v) {
+    const __m128i z = _mm_setzero_si128();
+    return _mm_add_epi64(_mm_unpacklo_epi32(v, z), _mm_unpackhi_epi32(v, z));
+}
+
+__attribute__((target("sse2")))
+static uint64_t sse8SSE2(const uint8_t* a, const uint8_t* b, int n) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i acc64 = z;
+    int k = 0;
+    while (k + 16 <= n) {
+        __m128i acc32 = z;
+        for (int steps = 0; steps < 4096 && k + 16 <= n; ++steps, k += 16) {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + k));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + k));
+            acc32 = _mm_add_epi32(acc32, sqDiff16x8(_mm_unpacklo_epi8(va, z), _mm_unpacklo_epi8(vb, z)));
+            acc32 = _mm_add_epi32(acc32, sqDiff16x8(_mm_unpackhi_epi8(va, z), _mm_unpackhi_epi8(vb, z)));
+        }
+        acc64 = _mm_add_epi64(acc64, widen32to64(acc32));
+    }
+    return hsum64(acc64) + sse8Scalar(a + k, b + k, n - k);
+}
+
+// ================= AVX2 (8 píxeles / 48 bytes por paso) =================
+
+__attribute__((target("avx2")))
+static void rasterRowAVX2(const RasterParams& p, int dy, int dx0, int n, float* out) {
+    const __m256 ct = _mm256_set1_ps(p.ct), st = _mm256_set1_ps(p.st);
+    const __m256 invs = _mm256_set1_ps(p.invs);
+    const __m256 limX = _mm256_set1_ps(p.limX), limY = _mm256_set1_ps(p.limY);
+    const __m256 bw1 = _mm256_set1_ps(p.bw1), bh1 = _mm256_set1_ps(p.bh1);
+    const __m256 mw1 = _mm256_set1_ps(float(p.mw - 1)), mh1 = _mm256_set1_ps(float(p.mh - 1));
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), k255 = _mm256_set1_ps(255.0f);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mwMax = _mm256_set1_epi32(p.mw - 1), mhMax = _mm256_set1_epi32(p.mh - 1);
+    const __m256i mw = _mm256_set1_epi32(p.mw), ione = _mm256_set1_epi32(1);
+    const __m256 fdy = _mm256_set1_ps(float(dy));
+    const __m256 dySt = _mm256_mul_ps(fdy, st), dyCt = _mm256_mul_ps(fdy, ct);
+    const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    alignas(32) int32_t idx[4][8];
+    alignas(32) int32_t xy[4][8];
+    alignas(32) int32_t m[4][8];
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 fdx = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(dx0 + i), iota));
+        const __m256 nfdx = _mm256_sub_ps(_mm256_setzero_ps(), fdx);
+        const __m256 xb = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(fdx, ct), dySt), invs);
+        const __m256 yb = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(nfdx, st), dyCt), invs);
+        const __m256 inside = _mm256_and_ps(
+            _mm256_cmp_ps(_mm256_and_ps(xb, absMask), limX, _CMP_LE_OQ),
+            _mm256_cmp_ps(_mm256_and_ps(yb, absMask), limY, _CMP_LE_OQ));
+        if (_mm256_movemask_ps(inside) == 0) {
+            _mm256_storeu_ps(out + i, _mm256_setzero_ps());
+            continue;
+        }
+        const __m256 fu = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(xb, bw1), half), mw1);
+        const __m256 fv = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(yb, bh1), half), mh1);
+        const __m256i x0 = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(fu)), zero), mwMax);
+        const __m256i y0 = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(fv)), zero), mhMax);
+        const __m256i x1 = _mm256_min_epi32(_mm256_add_epi32(x0, ione), mwMax);
+        const __m256i y1 = _mm256_min_epi32(_mm256_add_epi32(y0, ione), mhMax);
+        const __m256 ax = _mm256_sub_ps(fu, _mm256_cvtepi32_ps(x0));
+        const __m256 ay = _mm256_sub_ps(fv, _mm256_cvtepi32_ps(y0));
+
+        // Índices en SIMD; la lectura de bytes es escalar (un gather de 32
+        // bits podría leer fuera de la máscara en el último texel)
+        const __m256i r0 = _mm256_mullo_epi32(y0, mw), r1 = _mm256_mullo_epi32(y1, mw);
+        _mm256_store_si256((__m256i*)idx[0], _mm256_add_epi32(r0, x0));
+        _mm256_store_si256((__m256i*)idx[1], _mm256_add_epi32(r0, x1));
+        _mm256_store_si256((__m256i*)idx[2], _mm256_add_epi32(r1, x0));
+        _mm256_store_si256((__m256i*)idx[3], _mm256_add_epi32(r1, x1));
+        _mm256_store_si256((__m256i*)xy[0], x0);
+        _mm256_store_si256((__m256i*)xy[1], x1);
+        _mm256_store_si256((__m256i*)xy[2], y0);
+        _mm256_store_si256((__m256i*)xy[3], y1);
+        fetchTexels<8>(p, _mm256_movemask_ps(inside), idx, xy, m);
+
+        const __m256 m00 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)m[0])), k255);
+        const __m256 m10 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)m[1])), k255);
+        const __m256 m01 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)m[2])), k255);
+        const __m256 m11 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)m[3])), k255);
+
+        const __m256 nax = _mm256_sub_ps(one, ax), nay = _mm256_sub_ps(one, ay);
+        __m256 a = _mm256_mul_ps(_mm256_mul_ps(nax, nay), m00);
+        a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_mul_ps(ax, nay), m10));
+        a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_mul_ps(nax, ay), m01));
+        a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_mul_ps(ax, ay), m11));
+        _mm256_storeu_ps(out + i, _mm256_and_ps(a, inside));
+    }
+    if (i < n) rasterRowSSE41(p, dy, dx0 + i, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static inline __m128i blend8x16AVX2(__m128i bg8, __m128i al8, __m256i fg) {
+    const __m256i c255 = _mm256_set1_epi16(255), c128 = _mm256_set1_epi16(128);
+    const __m256i bg = _mm256_cvtepu8_epi16(bg8);
+    const __m256i al = _mm256_cvtepu8_epi16(al8);
+    __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(al, fg),
+                                 _mm256_mullo_epi16(_mm256_sub_epi16(c255, al), bg));
+    v = _mm256_add_epi16(v, c128);
+    v = _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("avx2")))
+static void blendRow8AVX2(uint8_t* dst, const uint8_t* a, const uint8_t* fg48, int nbytes) {
+    __m256i fg[3];
+    for (int c = 0; c < 3; ++c)
+        fg[c] = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(fg48 + 16 * c)));
+    int k = 0;
+    for (; k + 48 <= nbytes; k += 48) {
+        for (int c = 0; c < 3; ++c) {
+            uint8_t* d = dst + k + 16 * c;
+            const __m128i bg = _mm_loadu_si128((const __m128i*)d);
+            const __m128i al = _mm_loadu_si128((const __m128i*)(a + k + 16 * c));
+            _mm_storeu_si128((__m128i*)d, blend8x16AVX2(bg, al, fg[c]));
+        }
+    }
+    for (int c = 0; k + 16 <= nbytes; k += 16, ++c) {
+        const __m128i bg = _mm_loadu_si128((const __m128i*)(dst + k));
+        const __m128i al = _mm_loadu_si128((const __m128i*)(a + k));
+        _mm_storeu_si128((__m128i*)(dst + k), blend8x16AVX2(bg, al, fg[c]));
+    }
+    for (; k < nbytes; ++k) dst[k] = blend8(a[k], fg48[k % 48], dst[k]);
+}
+
+// Planar: 32 píxeles por paso
+__attribute__((target("avx2")))
+static void blendPlane8AVX2(uint8_t* dst, const uint8_t* a, uint8_t fg, int n) {
+    const __m256i f = _mm256_set1_epi16(fg);
+    int k = 0;
+    for (; k + 32 <= n; k += 32) {
+        for (int h = 0; h < 32; h += 16) {
+            const __m128i bg = _mm_loadu_si128((const __m128i*)(dst + k + h));
+            const __m128i al = _mm_loadu_si128((const __m128i*)(a + k + h));
+            _mm_storeu_si128((__m128i*)(dst + k + h), blend8x16AVX2(bg, al, f));
+        }
+    }
+    for (; k + 16 <= n; k += 16) {
+        const __m128i bg = _mm_loadu_si128((const __m128i*)(dst + k));
+        const __m128i al = _mm_loadu_si128((const __m128i*)(a + k));
+        _mm_storeu_si128((__m128i*)(dst + k), blend8x16AVX2(bg, al, f));
+    }
+    blendPlane8Scalar(dst + k, a + k, fg, n - k);
+}
+
+// Error cuadrático: 32 bytes por paso (cvtepu8 + madd)
+__attribute__((target("avx2")))
+static uint64_t sse8AVX2(const uint8_t* a, const uint8_t* b, int n) {
+    const __m256i z = _mm256_setzero_si256();
+    __m256i acc64 = z;
+    int k = 0;
+    while (k + 32 <= n) {
+        __m256i acc32 = z;
+        for (int steps = 0; steps < 4096 && k + 32 <= n; ++steps, k += 32) {
+            for (int h = 0; h < 32; h += 16) {
+                const __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + k + h)));
+                const __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + k + h)));
+                const __m256i d = _mm256_sub_epi16(va, vb);
+                acc32 = _mm256_add_epi32(acc32, _mm256_madd_epi16(d, d));
+            }
+        }
+        acc64 = _mm256_add_epi64(acc64, _mm256_unpacklo_epi32(acc32, z));
+        acc64 = _mm256_add_epi64(acc64, _mm256_unpackhi_epi32(acc32, z));
+    }
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(acc64), _mm256_extracti128_si256(acc64, 1));
+    return hsum64(s) + sse8SSE2(a + k, b + k, n - k);
+}
+
+#endif // STROKE_SIMD_X86
+
+// ================= Despacho =================
+
+SimdLevel detectSimdLevel() {
+#ifdef STROKE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+static StrokeKernels makeKernels(SimdLevel level) {
+    StrokeKernels k;
+    k.level = SimdLevel::Scalar;
+    k.rasterRow = rasterRowScalar;
+    k.blendRow8 = blendRow8Scalar;
+    k.blendPlane8 = blendPlane8Scalar;
+    k.sse8 = sse8Scalar;
+#ifdef STROKE_SIMD_X86
+    if (level == SimdLevel::SSE41) {
+        k.level = level;
+        k.rasterRow = rasterRowSSE41;
+        k.blendRow8 = blendRow8SSE41;
+        k.blendPlane8 = blendPlane8SSE41;
+        k.sse8 = sse8SSE2;
+    } else if (level == SimdLevel::AVX2) {
+        k.level = level;
+        k.rasterRow = rasterRowAVX2;
+        k.blendRow8 = blendRow8AVX2;
+        k.blendPlane8 = blendPlane8AVX2;
+        k.sse8 = sse8AVX2;
+    }
+#endif
+    return k;
+}
+
+static StrokeKernels gKernels = makeKernels(detectSimdLevel());
+
+const StrokeKernels& strokeKernels() { return gKernels; }
+
+void setSimdLevel(SimdLevel level) {
+    gKernels = makeKernels(std::min(level, detectSimdLevel()));
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2:  return "avx2";
+        case SimdLevel::SSE41: return "sse4.1";
+        default:               return "scalar";
+    }
+}
+
+bool parseSimdLevel(const std::string& name, SimdLevel& out) {
+    if (name == "scalar") out = SimdLevel::Scalar;
+    else if (name == "sse4.1" || name == "sse41") out = SimdLevel::SSE41;
+    else if (name == "avx2") out = SimdLevel::AVX2;
+    else if (name == "auto") out = detectSimdLevel();
+    else return false;
+    return true;
+}
+
+// ================= Verificación =================
+
+long long verifySimdKernels(const BrushAtlas& atlas, int n, unsigned seed) {
+    if (atlas.empty()) return 0;
+    const StrokeKernels saved = gKernels;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> U(0.0f, 1.0f);
+    RenderOptions opt;
+    opt.use_cache = false; // cada trazo se rasteriza con el kernel activo
+    opt.blend = BlendMode::Int8;
+
+    long long diffs = 0;
+    for (CanvasLayout layout : {CanvasLayout::Interleaved, CanvasLayout::Planar}) {
+        Canvas ref(48, 64, layout), test(48, 64, layout);
+        for (int t = 0; t < n; ++t) {
+            for (auto& v : ref.rgb) v = (uint8_t)(rng() & 0xFF);
+            test.rgb = ref.rgb;
+            Stroke s(U(rng) * 1.2f - 0.1f, U(rng) * 1.2f - 0.1f, 0.02f + U(rng) * 1.3f,
+                     U(rng) * 720.0f - 360.0f, int(rng() % atlas.size()),
+                     rng() & 0xFF, rng() & 0xFF, rng() & 0xFF);
+
+            gKernels = makeKernels(SimdLevel::Scalar);
+            s.draw(atlas, ref, opt);
+            gKernels = saved;
+            s.draw(atlas, test, opt);
+
+            for (size_t i = 0; i < ref.rgb.size(); ++i) diffs += (ref.rgb[i] != test.rgb[i]);
+        }
+    }
+
+    // Error cuadrático: largos y desalineaciones variados
+    std::vector<uint8_t> a(70000), b(70000);
+    for (int t = 0; t < n; ++t) {
+        const int off = int(rng() % 64);
+        const int len = (t % 8 == 0) ? int(rng() % (a.size() - off)) : int(rng() % 600);
+        for (int k = 0; k < off + len; ++k) { a[k] = uint8_t(rng()); b[k] = uint8_t(rng()); }
+        if (t % 4 == 0) std::fill_n(b.begin(), off + len, uint8_t(255 - a[0])); // diferencias grandes
+        if (t % 4 == 0) std::fill_n(a.begin(), off + len, a[0]);
+        diffs += (sse8Scalar(a.data() + off, b.data() + off, len) != saved.sse8(a.data() + off, b.data() + off, len));
+    }
+    gKernels = saved;
+    return diffs;
+}
@@ -0,0 +1,74 @@
+#ifndef STROKE_SIMD_H
+#define STROKE_SIMD_H
+
+#include <cstdint>
+#include <string>
+
+// ================= Kernels SIMD del rasterizador =================
+// Se elige el mejor kernel soportado por la CPU al arrancar (el binario se
+// compila sin -mavx2, así sigue siendo portable). Todos los niveles dan
+// exactamente el mismo resultado que el escalar.
+enum class SimdLevel { Scalar = 0, SSE41 = 1, AVX2 = 2 };
+
+// Transformación inversa destino -> brush de una huella
+struct RasterParams {
+    float ct = 1.0f, st = 0.0f;  // cos/sin de la rotación
+    float invs = 1.0f;           // 1 / escala
+    float limX = 0, limY = 0;    // (bw-1)/2, (bh-1)/2: fuera de esto alpha = 0
+    float bw1 = 1, bh1 = 1;      // bw-1, bh-1 (brush original)
+    const uint8_t* mip = nullptr;
+    int mw = 1, mh = 1;          // nivel mip que se muestrea
+    const int* span_x0 = nullptr; // tramos no nulos por fila del nivel mip
+    const int* span_x1 = nullptr;
+};
+
+// ¿Algún texel de las filas y0/y1 entre las columnas x0..x1 es no nulo?
+static inline bool texelsCovered(const RasterParams& p, int x0, int x1, int y0, int y1) {
+    return (x1 >= p.span_x0[y0] && x0 < p.span_x1[y0])
+        || (x1 >= p.span_x0[y1] && x0 < p.span_x1[y1]);
+}
+
+struct StrokeKernels {
+    SimdLevel level = SimdLevel::Scalar;
+
+    // alpha de los n píxeles de la fila dy que empiezan en dx0
+    void (*rasterRow)(const RasterParams& p, int dy, int dx0, int n, float* out);
+
+    // Mezcla int8 sobre bytes RGB intercalados: a = alpha ya repetido por
+    // canal, fg48 = r,g,b repetido 16 veces (la fila empieza en un píxel)
+    void (*blendRow8)(uint8_t* dst, const uint8_t* a, const uint8_t* fg48, int nbytes);
+
+    // Mezcla int8 de n píxeles contiguos de un plano (canvas planar)
+    void (*blendPlane8)(uint8_t* dst, const uint8_t* a, uint8_t fg, int n);
+
+    // Suma exacta de (a[k]-b[k])^2 sobre n bytes (error cuadrático)
+    uint64_t (*sse8)(const uint8_t* a, const uint8_t* b, int n);
+};
+
+// Mezcla int8 exacta: round((a*fg + (255-a)*bg) / 255) sin dividir
+static inline uint8_t blend8(uint32_t a, uint32_t fg, uint32_t bg) {
+    const uint32_t v = a * fg + (255u - a) * bg + 128u;
+    return (uint8_t)((v + (v >> 8)) >> 8);
+}
+
+// Kernel especializado para rotaciones múltiplo de 90° (quarter = 0..3):
+// sin cos/sin, y el eje que depende sólo de la fila se calcula una vez.
+// Da el mismo resultado que rasterRow con cos/sin exactos.
+void rasterRowQuarter(const RasterParams& p, int quarter, int dy, int dx0, int n, float* out);
+
+SimdLevel detectSimdLevel();
+const StrokeKernels& strokeKernels();
+void setSimdLevel(SimdLevel level); // se limita a lo que soporte la CPU
+
+const char* simdLevelName(SimdLevel level);
+bool parseSimdLevel(const std::string& name, SimdLevel& out);
+
+class BrushAtlas;
+
+// Compara el kernel activo contra el escalar sobre 'n' trazos aleatorios
+// (en canvas interleaved y planar).
+// También compara el kernel de error cuadrático sobre filas aleatorias.
+// Devuelve la cantidad de bytes (o sumas) distintos (0 = idénticos).
+long long verifySimdKernels(const BrushAtlas& atlas, int n, unsigned seed);
+
+#endif
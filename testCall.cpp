@@ -11,17 +11,8 @@ int randInt(int min, int max) {
 
 int main() {
     // 1) Cargar brushes desde carpeta
-    {
-        ImageGray b0, b1, b2, b3;
-        if (!loadImageGray("brushes/1.jpg", b0)) return 1;
-        if (!loadImageGray("brushes/2.jpg", b1)) return 1;
-        if (!loadImageGray("brushes/3.jpg", b2)) return 1;
-        if (!loadImageGray("brushes/4.jpg", b3)) return 1;
-        gBrushes.push_back(std::move(b0));
-        gBrushes.push_back(std::move(b1));
-        gBrushes.push_back(std::move(b2));
-        gBrushes.push_back(std::move(b3));
-    }
+    BrushAtlas atlas;
+    if (!atlas.loadDirectory("brushes")) return 1;
 
     // 2) Canvas, cambiar tamaño de acuerdo a la instancia
     Canvas C(48, 64);
@@ -40,7 +31,7 @@ int main() {
     strokes.push_back(s3);
 
     // 4) Renderiza (pinta) el vector de strokes en el canva C
-    render(strokes, C);
+    render(atlas, strokes, C);
 
     // 5) Guardar
     if (!savePNG(C, "output.png")) {